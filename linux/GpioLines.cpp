@@ -0,0 +1,94 @@
+/**
+ * CTW Nebenuhr - Output lines of a Linux GPIO chip
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "GpioLines.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+GpioLines::GpioLines(const std::string& chipPath, const std::vector<unsigned>& offsets)
+    : mChipPath(chipPath)
+    , mOffsets(offsets)
+{
+}
+
+GpioLines::~GpioLines()
+{
+    if (mFd >= 0) {
+        // Leave the coils unpowered
+        set(allLines(), 0);
+        close(mFd);
+    }
+}
+
+bool GpioLines::open(const char* consumer)
+{
+    if (mChipPath.empty()) {
+        return true;
+    }
+    if (mOffsets.empty() || mOffsets.size() > kMaxLines) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int chipFd = ::open(mChipPath.c_str(), O_RDWR | O_CLOEXEC);
+    if (chipFd < 0) {
+        return false;
+    }
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    for (size_t i = 0; i < mOffsets.size(); i++) {
+        request.offsets[i] = mOffsets[i];
+    }
+    request.num_lines = mOffsets.size();
+    strncpy(request.consumer, consumer, sizeof(request.consumer) - 1);
+    request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    // Start low, like the ESP8266 outputs after reset
+    request.config.num_attrs = 1;
+    request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    request.config.attrs[0].attr.values = 0;
+    request.config.attrs[0].mask = allLines();
+
+    int result = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request);
+    int error = errno;
+    close(chipFd);
+    if (result < 0) {
+        errno = error;
+        return false;
+    }
+    mFd = request.fd;
+    return true;
+}
+
+bool GpioLines::set(uint64_t mask, uint64_t bits)
+{
+    if (mFd < 0) {
+        return mChipPath.empty();
+    }
+    struct gpio_v2_line_values values;
+    values.mask = mask;
+    values.bits = bits & mask;
+    return ioctl(mFd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) == 0;
+}
+
+uint64_t GpioLines::allLines() const
+{
+    return mOffsets.size() >= 64 ? ~0ULL : (1ULL << mOffsets.size()) - 1;
+}
+
+int GpioLines::indexOf(unsigned offset) const
+{
+    for (size_t i = 0; i < mOffsets.size(); i++) {
+        if (mOffsets[i] == offset) {
+            return i;
+        }
+    }
+    return -1;
+}
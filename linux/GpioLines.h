@@ -0,0 +1,50 @@
+/**
+ * CTW Nebenuhr - Output lines of a Linux GPIO chip
+ *
+ * Uses the GPIO character device (uAPI v2, as libgpiod does) instead of the
+ * deprecated sysfs interface. All lines of a chip are requested together, so
+ * the pulses of any number of movements are switched with one ioctl and start
+ * at the same instant. Works with real chips and with the kernel's gpio-sim.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+class GpioLines {
+public:
+    // Lines per kernel line request
+    static const size_t kMaxLines = 64;
+
+    GpioLines(const std::string& chipPath, const std::vector<unsigned>& offsets);
+    ~GpioLines();
+
+    GpioLines(const GpioLines&) = delete;
+    GpioLines& operator=(const GpioLines&) = delete;
+
+    /**
+     * Request the lines as outputs, initially low. Without a chip path
+     * (dry run) nothing is requested and all writes succeed.
+     * Returns false and sets errno on failure.
+     */
+    bool open(const char* consumer);
+
+    /** Set the lines selected by mask (bit i = offsets[i]) to bits. */
+    bool set(uint64_t mask, uint64_t bits);
+
+    /** Index of a line in this request, for building masks. */
+    int indexOf(unsigned offset) const;
+
+    const std::string& chipPath() const { return mChipPath; }
+
+private:
+    uint64_t allLines() const;
+
+    std::string mChipPath;
+    std::vector<unsigned> mOffsets;
+    int mFd = -1;
+};
@@ -0,0 +1,400 @@
+/**
+ * CTW Nebenuhr - Linux daemon driving many slave clocks from one host
+ *
+ * The stepping rules of the ESP8266 firmware (src/StepPlanner.h) for any
+ * number of movements, each on two lines of a GPIO chip. Time comes from the
+ * host's disciplined CLOCK_REALTIME (chrony, ntpd, PTP); a timerfd fires on
+ * every full second, so regular pulses start on the minute boundary. All
+ * movements due on a tick are pulsed together with one ioctl per chip.
+ *
+ * Configuration, one movement per line:
+ *
+ *   # name   chip             line1 line2 zone
+ *   hall     /dev/gpiochip0   17    27    Europe/Berlin
+ *
+ * The dial positions are kept in the state file, written after every pulse.
+ * Edit it and send SIGHUP to correct a displayed time.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "GpioLines.h"
+#include "StepPlanner.h"
+
+static const char* CONSUMER = "nebenuhrd";
+// Like the ESP8266 pulse: 270 ms ramp and 200 ms at full current. The
+// character device has no PWM, so the coil is switched on at once.
+static const long PULSE_MILLIS = 470;
+static const int16_t MINUTES_PER_DAY = 1440;
+
+// One slave clock movement
+typedef struct {
+    std::string name;
+    std::string chipPath;
+    unsigned line1; // Driven high on odd minutes
+    unsigned line2; // Driven high on even minutes
+    std::string zone; // Timezone, empty for the host's local time
+    int16_t displayed; // What the dial shows, minutes from midnight
+    bool known; // Displayed time read from the state file
+    bool pulsing; // Pulse in progress
+    GpioLines* lines;
+    int index1;
+    int index2;
+} movement_t;
+
+static std::vector<movement_t> movements;
+static std::vector<std::unique_ptr<GpioLines>> lineGroups;
+static ThresholdPlanner planner(10);
+
+static std::string statePath = "/var/lib/nebenuhrd/state";
+static bool dryRun = false;
+
+/**
+ * Read the movements from the configuration file
+ */
+static bool readConfig(const char* path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "Cannot read %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        movement_t movement = {};
+        if (!(fields >> movement.name)) {
+            continue;
+        }
+        if (!(fields >> movement.chipPath >> movement.line1 >> movement.line2)) {
+            fprintf(stderr, "%s:%d: expected name, chip, line1, line2 [zone]\n", path, number);
+            return false;
+        }
+        fields >> movement.zone;
+        movements.push_back(movement);
+    }
+    return !movements.empty();
+}
+
+/**
+ * Request the output lines, batched per chip
+ */
+static bool openLines()
+{
+    std::map<std::string, std::vector<size_t>> byChip;
+    for (size_t i = 0; i < movements.size(); i++) {
+        byChip[movements[i].chipPath].push_back(i);
+    }
+
+    for (auto& chip : byChip) {
+        std::vector<size_t>& members = chip.second;
+        for (size_t first = 0; first < members.size(); first += GpioLines::kMaxLines / 2) {
+            size_t last = std::min(members.size(), first + GpioLines::kMaxLines / 2);
+            std::vector<unsigned> offsets;
+            for (size_t i = first; i < last; i++) {
+                offsets.push_back(movements[members[i]].line1);
+                offsets.push_back(movements[members[i]].line2);
+            }
+            lineGroups.emplace_back(new GpioLines(dryRun ? "" : chip.first, offsets));
+            GpioLines* lines = lineGroups.back().get();
+            if (!lines->open(CONSUMER)) {
+                fprintf(stderr, "Cannot request lines of %s: %s\n", chip.first.c_str(), strerror(errno));
+                return false;
+            }
+            for (size_t i = first; i < last; i++) {
+                movement_t& movement = movements[members[i]];
+                movement.lines = lines;
+                movement.index1 = lines->indexOf(movement.line1);
+                movement.index2 = lines->indexOf(movement.line2);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Load the dial positions, movements missing in the file stay unknown
+ */
+static void readState()
+{
+    std::ifstream in(statePath);
+    std::string name;
+    int displayed;
+    while (in >> name >> displayed) {
+        for (movement_t& movement : movements) {
+            if (movement.name == name && displayed >= 0 && displayed < MINUTES_PER_DAY) {
+                movement.displayed = displayed;
+                movement.known = true;
+            }
+        }
+    }
+}
+
+/**
+ * Persist the dial positions, replacing the state file atomically
+ */
+static bool writeState()
+{
+    std::string temporary = statePath + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "w");
+    if (!out) {
+        fprintf(stderr, "Cannot write %s: %s\n", temporary.c_str(), strerror(errno));
+        return false;
+    }
+    for (const movement_t& movement : movements) {
+        // A wrapped position is stored as the time the dial shows
+        fprintf(out, "%s %d\n", movement.name.c_str(), (movement.displayed + MINUTES_PER_DAY) % MINUTES_PER_DAY);
+    }
+    bool written = fflush(out) == 0 && fsync(fileno(out)) == 0;
+    written = fclose(out) == 0 && written;
+    if (!written || rename(temporary.c_str(), statePath.c_str()) != 0) {
+        fprintf(stderr, "Cannot write %s: %s\n", statePath.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Local time of a zone in minutes from midnight
+ */
+static int16_t localMinutes(const std::string& zone, time_t now)
+{
+    if (zone.empty()) {
+        unsetenv("TZ");
+    } else {
+        setenv("TZ", zone.c_str(), 1);
+    }
+    tzset();
+    struct tm local;
+    localtime_r(&now, &local);
+    return local.tm_hour * 60 + local.tm_min;
+}
+
+/**
+ * Decide for every movement and start the pulses of those to advance
+ * Returns true if a pulse was started
+ */
+static bool startPulses(time_t now)
+{
+    // tzset() per zone, not per movement
+    std::map<std::string, int16_t> targets;
+    std::map<GpioLines*, std::pair<uint64_t, uint64_t>> outputs;
+
+    for (movement_t& movement : movements) {
+        auto cached = targets.find(movement.zone);
+        if (cached == targets.end()) {
+            cached = targets.emplace(movement.zone, localMinutes(movement.zone, now)).first;
+        }
+        int16_t target = cached->second;
+        if (!movement.known) {
+            // First start, assume the dial was set to the right time
+            movement.displayed = target;
+            movement.known = true;
+        }
+
+        switch (planner.plan(movement.displayed, target)) {
+        case StepAction::Hold:
+            break;
+        case StepAction::Advance: {
+            // Alternating polarity, like advance() on the ESP8266
+            std::pair<uint64_t, uint64_t>& output = outputs[movement.lines];
+            uint64_t bit1 = 1ULL << movement.index1;
+            uint64_t bit2 = 1ULL << movement.index2;
+            output.first |= bit1 | bit2;
+            output.second |= movement.displayed % 2 == 0 ? bit2 : bit1;
+            movement.pulsing = true;
+            if (dryRun) {
+                fprintf(stderr, "%s: advance %02d:%02d, target %02d:%02d\n", movement.name.c_str(),
+                    (movement.displayed + MINUTES_PER_DAY) % MINUTES_PER_DAY / 60, (movement.displayed + MINUTES_PER_DAY) % 60,
+                    target / 60, target % 60);
+            }
+            break;
+        }
+        case StepAction::Wrap:
+            movement.displayed -= MINUTES_PER_DAY;
+            break;
+        }
+    }
+
+    for (auto& output : outputs) {
+        if (!output.first->set(output.second.first, output.second.second)) {
+            fprintf(stderr, "Cannot set lines of %s: %s\n", output.first->chipPath().c_str(), strerror(errno));
+        }
+    }
+    return !outputs.empty();
+}
+
+/**
+ * Switch the coils off and account for the finished pulses
+ */
+static void endPulses()
+{
+    std::map<GpioLines*, uint64_t> masks;
+    for (movement_t& movement : movements) {
+        if (!movement.pulsing) {
+            continue;
+        }
+        masks[movement.lines] |= (1ULL << movement.index1) | (1ULL << movement.index2);
+        movement.pulsing = false;
+        movement.displayed++;
+        if (movement.displayed >= MINUTES_PER_DAY) {
+            movement.displayed -= MINUTES_PER_DAY;
+        }
+    }
+    for (auto& mask : masks) {
+        if (!mask.first->set(mask.second, 0)) {
+            fprintf(stderr, "Cannot reset lines of %s: %s\n", mask.first->chipPath().c_str(), strerror(errno));
+        }
+    }
+    writeState();
+}
+
+/**
+ * Arm the tick timer for every full second of CLOCK_REALTIME
+ * It is cancelled when the clock is set, so a step is noticed at once.
+ */
+static bool armTicks(int tickFd)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = now.tv_sec + 1;
+    spec.it_interval.tv_sec = 1;
+    return timerfd_settime(tickFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr) == 0;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [-c config] [-s state] [-n]\n"
+                    "  -c  configuration file (default /etc/nebenuhrd.conf)\n"
+                    "  -s  state file with the dial positions (default %s)\n"
+                    "  -n  dry run, decide and log without touching GPIOs\n",
+        program, statePath.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    const char* configPath = "/etc/nebenuhrd.conf";
+    int option;
+    while ((option = getopt(argc, argv, "c:s:n")) != -1) {
+        switch (option) {
+        case 'c':
+            configPath = optarg;
+            break;
+        case 's':
+            statePath = optarg;
+            break;
+        case 'n':
+            dryRun = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (!readConfig(configPath) || !openLines()) {
+        return 1;
+    }
+    readState();
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    int signalFd = signalfd(-1, &signals, SFD_CLOEXEC);
+    int tickFd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+    int pulseFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (signalFd < 0 || tickFd < 0 || pulseFd < 0 || !armTicks(tickFd)) {
+        fprintf(stderr, "Cannot set up timers: %s\n", strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "Driving %zu movements%s\n", movements.size(), dryRun ? " (dry run)" : "");
+
+    struct pollfd fds[] = {
+        { tickFd, POLLIN, 0 },
+        { pulseFd, POLLIN, 0 },
+        { signalFd, POLLIN, 0 },
+    };
+    bool running = true;
+    while (running) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "poll: %s\n", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(pulseFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                endPulses();
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(tickFd, &expirations, sizeof(expirations)) < 0) {
+                if (errno == ECANCELED) {
+                    // Clock was set, realign to the new second boundary
+                    fprintf(stderr, "System clock was set\n");
+                    armTicks(tickFd);
+                }
+            } else if (startPulses(time(nullptr))) {
+                struct itimerspec spec = {};
+                spec.it_value.tv_nsec = PULSE_MILLIS * 1000000L;
+                timerfd_settime(pulseFd, 0, &spec, nullptr);
+            }
+        }
+
+        if (fds[2].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+                if (info.ssi_signo == SIGHUP) {
+                    fprintf(stderr, "Reloading %s\n", statePath.c_str());
+                    readState();
+                } else {
+                    running = false;
+                }
+            }
+        }
+    }
+
+    // Finish a running pulse, so the dial positions stay right
+    for (const movement_t& movement : movements) {
+        if (movement.pulsing) {
+            struct itimerspec remaining = {};
+            timerfd_gettime(pulseFd, &remaining);
+            nanosleep(&remaining.it_value, nullptr);
+            endPulses();
+            break;
+        }
+    }
+    writeState();
+    lineGroups.clear();
+    return 0;
+}
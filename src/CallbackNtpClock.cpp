@@ -0,0 +1,146 @@
+/**
+ * CTW Nebenuhr - NTP client with receive timestamps taken in the lwIP callback
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "CallbackNtpClock.h"
+#include "NtpTime.h"
+
+#include <ESP8266WiFi.h>
+#include <lwip/pbuf.h>
+#include <lwip/udp.h>
+
+using ace_time::Epoch;
+
+/**
+ * lwIP receive callback - runs in the network stack context, as soon as the
+ * packet is delivered, independent of what loop() is currently doing.
+ */
+static void ntpReceive(void* arg, struct udp_pcb* /*pcb*/, struct pbuf* p,
+    const ip_addr_t* /*addr*/, u16_t /*port*/)
+{
+    uint32_t receiveCycles = ESP.getCycleCount();
+    static_cast<CallbackNtpClock*>(arg)->onPacket(p, receiveCycles);
+    pbuf_free(p);
+}
+
+CallbackNtpClock::CallbackNtpClock(const char* server)
+    : mServer(server)
+{
+}
+
+void CallbackNtpClock::setup()
+{
+    if (mPcb) {
+        return;
+    }
+    mPcb = udp_new();
+    if (mPcb) {
+        udp_recv(mPcb, ntpReceive, this);
+    }
+}
+
+bool CallbackNtpClock::canSendRequest() const
+{
+    return mPcb && WiFi.status() == WL_CONNECTED;
+}
+
+void CallbackNtpClock::sendRequest() const
+{
+    if (!canSendRequest()) {
+        return;
+    }
+
+    IPAddress serverIp;
+    if (!WiFi.hostByName(mServer, serverIp)) {
+        return;
+    }
+
+    uint8_t packet[kNtpPacketSize];
+    memset(packet, 0, sizeof(packet));
+    packet[0] = 0b11100011; // LI unsynchronized, version 4, mode client
+    packet[2] = 6; // polling interval
+    packet[3] = 0xEC; // peer clock precision
+
+    // Random transmit timestamp - the server echoes it as origin timestamp,
+    // which lets us drop stale or spoofed replies
+    mCookie = ESP.random();
+    memcpy(&packet[44], &mCookie, sizeof(mCookie));
+
+    struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, kNtpPacketSize, PBUF_RAM);
+    if (!p) {
+        return;
+    }
+    pbuf_take(p, packet, kNtpPacketSize);
+
+    mResponseReady = false;
+    mSendCycles = ESP.getCycleCount();
+    udp_sendto(mPcb, p, serverIp, kNtpPort);
+    pbuf_free(p);
+}
+
+void CallbackNtpClock::onPacket(struct pbuf* p, uint32_t receiveCycles)
+{
+    if (mResponseReady || p->tot_len < kNtpPacketSize) {
+        return;
+    }
+
+    uint8_t packet[kNtpPacketSize];
+    pbuf_copy_partial(p, packet, kNtpPacketSize, 0);
+
+    uint8_t mode = packet[0] & 0x07;
+    uint8_t stratum = packet[1];
+    if (mode != 4 || stratum == 0 || memcmp(&packet[28], &mCookie, sizeof(mCookie)) != 0) {
+        // Not a server reply, kiss-of-death or not an answer to our request
+        return;
+    }
+
+    memcpy(mServerTimestamps, &packet[32], sizeof(mServerTimestamps));
+    mReceiveCycles = receiveCycles;
+    mResponseReady = true;
+}
+
+bool CallbackNtpClock::isResponseReady() const
+{
+    return mResponseReady;
+}
+
+int64_t CallbackNtpClock::readResponseMillis() const
+{
+    // Local timestamps (T1, T4) from the cycle counter, server ones (T2, T3)
+    // from the packet
+    ntp_exchange_t exchange;
+    exchange.sendCycles = mSendCycles;
+    exchange.receiveCycles = mReceiveCycles;
+    exchange.readCycles = ESP.getCycleCount();
+    exchange.cyclesPerMicro = ESP.getCpuFreqMHz();
+    exchange.serverReceiveMicros = ntpToUnixMicros(&mServerTimestamps[0]);
+    exchange.serverTransmitMicros = ntpToUnixMicros(&mServerTimestamps[8]);
+    ntp_result_t result = ntpEvaluate(exchange);
+
+    mLastDelayMicros = result.delayMicros;
+    mLastResponseAgeMicros = result.ageMicros;
+    mResponseReady = false;
+    return result.unixMicros / 1000;
+}
+
+acetime_t CallbackNtpClock::readResponse() const
+{
+    // Round instead of truncating: a second resolution clock starts its
+    // second at the moment of the sync, so this halves the phase error
+    int64_t unixMillis = readResponseMillis() + 500;
+    return (acetime_t)(unixMillis / 1000 - Epoch::secondsToCurrentEpochFromUnixEpoch64());
+}
+
+acetime_t CallbackNtpClock::getNow() const
+{
+    sendRequest();
+    unsigned long startMillis = millis();
+    while (!isResponseReady()) {
+        if (millis() - startMillis > kRequestTimeoutMillis) {
+            return kInvalidSeconds;
+        }
+        delay(1);
+    }
+    return readResponse();
+}
@@ -0,0 +1,74 @@
+/**
+ * CTW Nebenuhr - NTP client with receive timestamps taken in the lwIP callback
+ *
+ * The stock NtpClock polls its WiFiUDP socket from loop(), so a reply that
+ * arrives while advance() is pulsing the coil or handleRoot() is streaming
+ * gets timestamped late, and the delay ends up in the clock offset.
+ * This client registers a raw lwIP UDP receive callback instead and captures
+ * the CPU cycle counter the moment the packet is handed to us. Offset and
+ * round-trip delay are computed from those timestamps, and the time handed to
+ * the caller is advanced by however long the packet waited to be read.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <AceTimeClock.h>
+#include <IPAddress.h>
+
+struct udp_pcb;
+struct pbuf;
+
+class CallbackNtpClock : public ace_time::clock::Clock {
+public:
+    static const uint16_t kNtpPort = 123;
+    static const uint8_t kNtpPacketSize = 48;
+    static const uint16_t kRequestTimeoutMillis = 1000;
+
+    explicit CallbackNtpClock(const char* server);
+
+    /** Allocate the UDP control block and register the receive callback. */
+    void setup();
+
+    bool isSetup() const { return mPcb != nullptr; }
+
+    /** False while there is no network, requests would be lost anyway. */
+    bool canSendRequest() const;
+
+    /** Blocking request, waits up to kRequestTimeoutMillis for the reply. */
+    acetime_t getNow() const override;
+
+    void sendRequest() const override;
+    bool isResponseReady() const override;
+    acetime_t readResponse() const override;
+
+    /**
+     * Unix time in milliseconds at the moment of the call, derived from the
+     * last reply. Only valid directly after isResponseReady() returned true.
+     */
+    int64_t readResponseMillis() const;
+
+    /** Round-trip delay of the last exchange, without server processing time. */
+    int32_t getLastDelayMicros() const { return mLastDelayMicros; }
+
+    /** Time the last reply waited between arrival and readResponse(). */
+    uint32_t getLastResponseAgeMicros() const { return mLastResponseAgeMicros; }
+
+    /** Called from the lwIP receive callback, do not call directly. */
+    void onPacket(struct pbuf* p, uint32_t receiveCycles);
+
+private:
+    const char* const mServer;
+    udp_pcb* mPcb = nullptr;
+
+    // Written by sendRequest()/onPacket(), hence mutable and volatile
+    mutable uint32_t mCookie = 0;
+    mutable uint32_t mSendCycles = 0;
+    mutable volatile uint32_t mReceiveCycles = 0;
+    mutable volatile bool mResponseReady = false;
+    mutable uint8_t mServerTimestamps[16]; // receive (T2) and transmit (T3) time
+
+    mutable int32_t mLastDelayMicros = 0;
+    mutable uint32_t mLastResponseAgeMicros = 0;
+};
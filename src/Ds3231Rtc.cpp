@@ -0,0 +1,174 @@
+/**
+ * CTW Nebenuhr - Battery-backed DS3231 real time clock on I2C
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "Ds3231Rtc.h"
+
+static const uint8_t REG_SECONDS = 0x00;
+static const uint8_t REG_ALARM1 = 0x07;
+static const uint8_t REG_ALARM2 = 0x0B;
+static const uint8_t REG_CONTROL = 0x0E;
+static const uint8_t REG_STATUS = 0x0F;
+
+static const uint8_t CONTROL_INTCN = 0x04; // INT/SQW pin used for alarms, not the square wave
+static const uint8_t CONTROL_A2IE = 0x02;
+static const uint8_t CONTROL_A1IE = 0x01;
+static const uint8_t STATUS_OSF = 0x80; // Oscillator stopped, time invalid
+
+// 2000-01-01T00:00:00Z, start of the chip's century
+static const int64_t UNIX_2000 = 946684800;
+
+static uint8_t fromBcd(uint8_t value)
+{
+    return (value >> 4) * 10 + (value & 0x0f);
+}
+
+static uint8_t toBcd(uint8_t value)
+{
+    return ((value / 10) << 4) | (value % 10);
+}
+
+// Days since 2000-01-01 of a date in 2000..2099, the chip's range
+static int32_t daysSince2000(int32_t year, int32_t month, int32_t day)
+{
+    // Count years from March, the leap day is then the last day of a year
+    if (month <= 2) {
+        year--;
+        month += 12;
+    }
+    int32_t yearDays = 365 * year + year / 4 - year / 100 + year / 400;
+    return yearDays + (153 * (month - 3) + 2) / 5 + day - 1 - 730425;
+}
+
+static void dateSince2000(int32_t days, int32_t& year, uint8_t& month, uint8_t& day)
+{
+    // Inverse of daysSince2000(), in 400 year cycles counted from 0000-03-01
+    int32_t daysSince0 = days + 730425;
+    int32_t cycle = daysSince0 / 146097;
+    int32_t dayOfCycle = daysSince0 - cycle * 146097;
+    int32_t yearOfCycle = (dayOfCycle - dayOfCycle / 1460 + dayOfCycle / 36524 - dayOfCycle / 146096) / 365;
+    int32_t dayOfYear = dayOfCycle - (365 * yearOfCycle + yearOfCycle / 4 - yearOfCycle / 100);
+    int32_t monthFromMarch = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+    month = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+    year = cycle * 400 + yearOfCycle + (month <= 2 ? 1 : 0);
+}
+
+bool Ds3231Rtc::readRegisters(uint8_t reg, uint8_t* data, uint8_t length)
+{
+    return mBus.readRegisters(kAddress, reg, data, length);
+}
+
+bool Ds3231Rtc::writeRegisters(uint8_t reg, const uint8_t* data, uint8_t length)
+{
+    return mBus.writeRegisters(kAddress, reg, data, length);
+}
+
+bool Ds3231Rtc::begin()
+{
+    uint8_t control;
+    mPresent = readRegisters(REG_CONTROL, &control, 1);
+    if (!mPresent) {
+        return false;
+    }
+    // The alarm registers hold our data, their matches must not signal
+    control = (control | CONTROL_INTCN) & ~(CONTROL_A1IE | CONTROL_A2IE);
+    return writeRegisters(REG_CONTROL, &control, 1);
+}
+
+bool Ds3231Rtc::readUnixSeconds(int64_t& unixSeconds)
+{
+    uint8_t status;
+    uint8_t time[7];
+    if (!mPresent || !readRegisters(REG_STATUS, &status, 1) || (status & STATUS_OSF)
+        || !readRegisters(REG_SECONDS, time, sizeof(time))) {
+        return false;
+    }
+    // Always written in 24 hour mode, the century bit is ignored
+    uint8_t second = fromBcd(time[0] & 0x7f);
+    uint8_t minute = fromBcd(time[1] & 0x7f);
+    uint8_t hour = fromBcd(time[2] & 0x3f);
+    uint8_t day = fromBcd(time[4] & 0x3f);
+    uint8_t month = fromBcd(time[5] & 0x1f);
+    uint8_t year = fromBcd(time[6]);
+    if (second > 59 || minute > 59 || hour > 23 || day < 1 || day > 31
+        || month < 1 || month > 12 || year > 99) {
+        return false;
+    }
+    int64_t days = daysSince2000(2000 + year, month, day);
+    unixSeconds = UNIX_2000 + days * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+bool Ds3231Rtc::writeUnixSeconds(int64_t unixSeconds)
+{
+    if (!mPresent || unixSeconds < UNIX_2000) {
+        return false;
+    }
+    int32_t days = (unixSeconds - UNIX_2000) / 86400;
+    uint32_t secondOfDay = (unixSeconds - UNIX_2000) % 86400;
+    int32_t year;
+    uint8_t month;
+    uint8_t day;
+    dateSince2000(days, year, month, day);
+    if (year > 2099) {
+        return false;
+    }
+    uint8_t time[7] = {
+        toBcd(secondOfDay % 60),
+        toBcd(secondOfDay / 60 % 60),
+        toBcd(secondOfDay / 3600),
+        // 1 = Monday ... 7 = Sunday, 2000-01-01 was a Saturday
+        (uint8_t)((days + 5) % 7 + 1),
+        toBcd(day),
+        toBcd(month),
+        toBcd(year - 2000),
+    };
+    uint8_t status;
+    if (!writeRegisters(REG_SECONDS, time, sizeof(time)) || !readRegisters(REG_STATUS, &status, 1)) {
+        return false;
+    }
+    // The time is valid again
+    status &= ~STATUS_OSF;
+    return writeRegisters(REG_STATUS, &status, 1);
+}
+
+bool Ds3231Rtc::readDial(int16_t& displayed)
+{
+    uint8_t data[3];
+    if (!mPresent || !readRegisters(REG_ALARM2, data, sizeof(data))
+        || data[2] != (uint8_t)(data[0] ^ data[1] ^ 0xa5)) {
+        return false;
+    }
+    displayed = data[0] | (data[1] << 8);
+    return displayed >= 0 && displayed < 1440;
+}
+
+bool Ds3231Rtc::writeDial(int16_t displayed)
+{
+    // Negative while catching up across midnight, readDial() wants 0..1439
+    displayed = (displayed % 1440 + 1440) % 1440;
+    uint8_t data[3] = { (uint8_t)displayed, (uint8_t)(displayed >> 8), 0 };
+    data[2] = data[0] ^ data[1] ^ 0xa5;
+    return mPresent && writeRegisters(REG_ALARM2, data, sizeof(data));
+}
+
+bool Ds3231Rtc::readHeartbeat(int64_t& unixSeconds)
+{
+    uint32_t seconds;
+    if (!mPresent || !readRegisters(REG_ALARM1, (uint8_t*)&seconds, sizeof(seconds))) {
+        return false;
+    }
+    unixSeconds = UNIX_2000 + seconds;
+    return true;
+}
+
+bool Ds3231Rtc::writeHeartbeat(int64_t unixSeconds)
+{
+    if (unixSeconds < UNIX_2000) {
+        return false;
+    }
+    uint32_t seconds = unixSeconds - UNIX_2000;
+    return mPresent && writeRegisters(REG_ALARM1, (const uint8_t*)&seconds, sizeof(seconds));
+}
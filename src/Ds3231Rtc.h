@@ -0,0 +1,66 @@
+/**
+ * CTW Nebenuhr - Battery-backed DS3231 real time clock on I2C
+ *
+ * Without an RTC, setup() knows neither the time nor how long the power was
+ * out before the network is up. The DS3231 keeps UTC across outages and,
+ * with its temperature compensated oscillator (+-2 ppm), drifts much less
+ * than the ESP8266 crystal, so it also serves as holdover reference while
+ * NTP is unreachable.
+ *
+ * The alarm registers are not used as alarms (their interrupts are disabled
+ * in begin()) but as battery-backed storage:
+ *
+ *   0x07..0x0A  alarm 1   last-alive time, seconds since 2000-01-01 UTC
+ *   0x0B..0x0D  alarm 2   dial position in minutes and a check byte
+ *
+ * Registers are accessed through an I2cBus, so the driver runs against a
+ * fake register file in the host tests.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include "I2cBus.h"
+
+class Ds3231Rtc {
+public:
+    static const uint8_t kAddress = 0x68;
+
+    explicit Ds3231Rtc(I2cBus& bus)
+        : mBus(bus)
+    {
+    }
+
+    /** Probe the chip and disable its alarm interrupts, the bus must be up. */
+    bool begin();
+
+    bool isPresent() const { return mPresent; }
+
+    /**
+     * Current time in unix seconds. False if there is no chip or the
+     * oscillator stopped (battery empty, first power-on), as the time is
+     * invalid then.
+     */
+    bool readUnixSeconds(int64_t& unixSeconds);
+
+    /**
+     * Set the time, best right at a second boundary: writing the seconds
+     * restarts the chip's countdown to the next second.
+     */
+    bool writeUnixSeconds(int64_t unixSeconds);
+
+    /** Dial position kept in the alarm 2 registers, false if never stored. */
+    bool readDial(int16_t& displayed);
+    bool writeDial(int16_t displayed);
+
+    /** Last time the controller was known to run, kept in alarm 1. */
+    bool readHeartbeat(int64_t& unixSeconds);
+    bool writeHeartbeat(int64_t unixSeconds);
+
+private:
+    bool readRegisters(uint8_t reg, uint8_t* data, uint8_t length);
+    bool writeRegisters(uint8_t reg, const uint8_t* data, uint8_t length);
+
+    I2cBus& mBus;
+    bool mPresent = false;
+};
@@ -0,0 +1,24 @@
+/**
+ * CTW Nebenuhr - Register access on an I2C bus
+ *
+ * Drivers of register based chips (DS3231, ...) only read and write blocks
+ * of consecutive registers. Behind this interface they run against the
+ * Arduino Wire library on the clock (WireBus) and against a register file
+ * in host tests.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <stdint.h>
+
+class I2cBus {
+public:
+    virtual ~I2cBus() { }
+
+    /** Read length registers starting at reg, false if the chip does not answer. */
+    virtual bool readRegisters(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length) = 0;
+
+    /** Write length registers starting at reg. */
+    virtual bool writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length) = 0;
+};
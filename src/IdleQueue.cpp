@@ -0,0 +1,61 @@
+/**
+ * CTW Nebenuhr - Deferred maintenance work, run in scheduler slack only
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "IdleQueue.h"
+
+bool IdleQueue::enqueue(IdleJob* job)
+{
+    if (job->mQueued) {
+        return true;
+    }
+    if (mCount == kCapacity) {
+        mDropped++;
+        return false;
+    }
+    mJobs[(mHead + mCount) % kCapacity] = job;
+    mCount++;
+    if (mCount > mMaxDepth) {
+        mMaxDepth = mCount;
+    }
+    job->mQueued = true;
+    return true;
+}
+
+void IdleQueue::run(unsigned long budgetMicros)
+{
+    mOfferedMicros += budgetMicros;
+    if (mCount == 0) {
+        return;
+    }
+
+    unsigned long start = micros();
+    unsigned long elapsed = 0;
+    while (mCount > 0 && elapsed < budgetMicros) {
+        // Round robin, a long job must not starve the others
+        IdleJob* job = mJobs[mHead];
+        mHead = (mHead + 1) % kCapacity;
+        mCount--;
+        if (job->step()) {
+            job->mQueued = false;
+            mCompleted++;
+        } else {
+            mJobs[(mHead + mCount) % kCapacity] = job;
+            mCount++;
+        }
+        elapsed = micros() - start;
+    }
+
+    mBusyMicros += elapsed;
+}
+
+uint8_t IdleQueue::utilisationPercent() const
+{
+    if (mOfferedMicros == 0) {
+        return 0;
+    }
+    // A slice may overrun the budget a little, cap the result
+    uint64_t percent = mBusyMicros * 100 / mOfferedMicros;
+    return percent > 100 ? 100 : (uint8_t)percent;
+}
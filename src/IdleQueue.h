@@ -0,0 +1,65 @@
+/**
+ * CTW Nebenuhr - Deferred maintenance work, run in scheduler slack only
+ *
+ * Expensive but non-urgent work (sorting the zone list, the periodic
+ * EEPROM commit of the statistics, ...) must not run inline in a web handler
+ * or right before a minute pulse. Jobs are split into short resumable slices;
+ * loop() hands the queue a time budget whenever no pulse, NTP exchange or
+ * HTTP request is due.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+class IdleJob {
+public:
+    virtual ~IdleJob() { }
+
+    /** Do one bounded slice of work, return true once the job is finished. */
+    virtual bool step() = 0;
+
+    virtual const char* name() const = 0;
+
+private:
+    friend class IdleQueue;
+    bool mQueued = false;
+};
+
+class IdleQueue {
+public:
+    static const uint8_t kCapacity = 8;
+
+    /** Queue a job, a job already waiting is not queued twice. */
+    bool enqueue(IdleJob* job);
+
+    /**
+     * Run job slices until the budget is used up or the queue is empty.
+     * A slice is never interrupted, so jobs must keep them well below it.
+     * The only exception are single operations that cannot be split, like
+     * a flash sector erase: they may overrun, as the queue only runs with
+     * seconds to spare before the next minute step (catch-up steps just
+     * wait). Anything that must not be lost on reset is not deferred at all.
+     */
+    void run(unsigned long budgetMicros);
+
+    uint8_t depth() const { return mCount; }
+    uint8_t maxDepth() const { return mMaxDepth; }
+    uint32_t completedJobs() const { return mCompleted; }
+    uint32_t droppedJobs() const { return mDropped; }
+
+    /** Share of the offered slack actually spent in jobs, in percent. */
+    uint8_t utilisationPercent() const;
+
+private:
+    IdleJob* mJobs[kCapacity];
+    uint8_t mHead = 0;
+    uint8_t mCount = 0;
+    uint8_t mMaxDepth = 0;
+
+    uint32_t mCompleted = 0;
+    uint32_t mDropped = 0;
+    uint64_t mOfferedMicros = 0;
+    uint64_t mBusyMicros = 0;
+};
@@ -0,0 +1,100 @@
+/**
+ * CTW Nebenuhr - Follower mode for an existing master clock (Hauptuhr) line
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "MasterLine.h"
+
+volatile unsigned long MasterLine::sQueue[kQueueSize];
+volatile uint8_t MasterLine::sHead = 0;
+volatile uint8_t MasterLine::sCount = 0;
+volatile unsigned long MasterLine::sLastEdgeMillis = 0;
+
+void IRAM_ATTR MasterLine::onEdge()
+{
+    unsigned long now = millis();
+    if (now - sLastEdgeMillis < kDebounceMillis) {
+        return;
+    }
+    sLastEdgeMillis = now;
+    // A full queue means loop() is stuck, older impulses are kept
+    if (sCount < kQueueSize) {
+        sQueue[(sHead + sCount) % kQueueSize] = now;
+        sCount++;
+    }
+}
+
+void MasterLine::begin(uint8_t pin)
+{
+    pinMode(pin, INPUT_PULLUP);
+    sLastEdgeMillis = millis() - kDebounceMillis;
+    attachInterrupt(digitalPinToInterrupt(pin), onEdge, FALLING);
+}
+
+bool MasterLine::takePulse(unsigned long& timestamp)
+{
+    bool available = false;
+    noInterrupts();
+    if (sCount > 0) {
+        timestamp = sQueue[sHead];
+        sHead = (sHead + 1) % kQueueSize;
+        sCount--;
+        available = true;
+    }
+    interrupts();
+    return available;
+}
+
+MasterLine::Event MasterLine::poll()
+{
+    unsigned long timestamp;
+    if (takePulse(timestamp)) {
+        mPulses++;
+        unsigned long period = timestamp - mLastPulseMillis;
+        bool havePrevious = mHavePulse;
+        mHavePulse = true;
+        mLastPulseMillis = timestamp;
+
+        if (havePrevious && period < kMinPeriodMillis) {
+            mExtra++;
+            mRegularPulses = 0;
+            if (mFollowing) {
+                mFollowing = false;
+                return kExtra;
+            }
+            return kNone;
+        }
+        if (mFollowing) {
+            return kPulse;
+        }
+
+        // Not following yet, wait for a run of regular impulses
+        if (havePrevious && period <= kMaxPeriodMillis) {
+            mRegularPulses++;
+        } else {
+            mRegularPulses = 1;
+        }
+        if (mRegularPulses >= kLockPulses) {
+            mFollowing = true;
+            return kLocked;
+        }
+        return kNone;
+    }
+
+    if (mFollowing && millis() - mLastPulseMillis > kMaxPeriodMillis) {
+        mMissing++;
+        mFollowing = false;
+        mRegularPulses = 0;
+        return kMissing;
+    }
+    return kNone;
+}
+
+void MasterLine::reject()
+{
+    if (mFollowing) {
+        mRejected++;
+    }
+    mFollowing = false;
+    mRegularPulses = 0;
+}
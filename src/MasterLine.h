@@ -0,0 +1,82 @@
+/**
+ * CTW Nebenuhr - Follower mode for an existing master clock (Hauptuhr) line
+ *
+ * Retrofits a single slave on a line that is still driven by a legacy master
+ * clock. The alternating 24 V minute impulses are fed through a rectifier and
+ * an optocoupler that pulls the input low for the duration of an impulse.
+ * Impulses are timestamped by interrupt, so none is lost while loop() is
+ * blocked by a coil pulse or a TLS handshake.
+ *
+ * The line is only followed after kLockPulses regular impulses. Impulses
+ * closer than kMinPeriodMillis (extra) or a gap longer than kMaxPeriodMillis
+ * (missing) end following, as does reject() when the impulses disagree with
+ * NTP. Both also happen when the master corrects itself, e.g. by running fast
+ * or pausing an hour at a DST change; NTP drives the movement meanwhile.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+class MasterLine {
+public:
+    // Longer than an impulse, so bounce on release is ignored as well
+    static const unsigned long kDebounceMillis = 1500;
+    // Impulses closer than this are extra
+    static const unsigned long kMinPeriodMillis = 30000;
+    // No impulse for this long while following is a missing one
+    static const unsigned long kMaxPeriodMillis = 65000;
+    // Regular impulses needed before the line is followed
+    static const uint8_t kLockPulses = 3;
+
+    enum Event : uint8_t {
+        kNone, // Nothing to do
+        kPulse, // Impulse to follow with the movement
+        kLocked, // Regular impulses, following from the next one on
+        kMissing, // Impulse missing, stopped following
+        kExtra, // Extra impulse, stopped following
+    };
+
+    /** Configure the input and attach the interrupt. Single instance only. */
+    void begin(uint8_t pin);
+
+    /**
+     * Process the next timestamped impulse or a timeout, one event per call.
+     * Call from loop() until it returns kNone.
+     */
+    Event poll();
+
+    /** Stop following, e.g. because the impulses disagree with NTP. */
+    void reject();
+
+    bool isFollowing() const { return mFollowing; }
+    unsigned long getLastPulseMillis() const { return mLastPulseMillis; }
+
+    uint32_t getPulseCount() const { return mPulses; }
+    uint32_t getMissingCount() const { return mMissing; }
+    uint32_t getExtraCount() const { return mExtra; }
+    uint32_t getRejectCount() const { return mRejected; }
+
+private:
+    static const uint8_t kQueueSize = 4;
+
+    static void IRAM_ATTR onEdge();
+    bool takePulse(unsigned long& timestamp);
+
+    // Written by the interrupt handler
+    static volatile unsigned long sQueue[kQueueSize];
+    static volatile uint8_t sHead;
+    static volatile uint8_t sCount;
+    static volatile unsigned long sLastEdgeMillis;
+
+    bool mFollowing = false;
+    bool mHavePulse = false;
+    uint8_t mRegularPulses = 0;
+    unsigned long mLastPulseMillis = 0;
+
+    uint32_t mPulses = 0;
+    uint32_t mMissing = 0;
+    uint32_t mExtra = 0;
+    uint32_t mRejected = 0;
+};
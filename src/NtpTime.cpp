@@ -0,0 +1,39 @@
+/**
+ * CTW Nebenuhr - NTP timestamp arithmetic
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "NtpTime.h"
+
+// Seconds between 1900-01-01 (NTP era 0) and 1970-01-01
+static const uint32_t NTP_UNIX_OFFSET = 2208988800UL;
+
+int64_t ntpToUnixMicros(const uint8_t* timestamp)
+{
+    uint32_t seconds = (uint32_t)timestamp[0] << 24 | (uint32_t)timestamp[1] << 16
+        | (uint32_t)timestamp[2] << 8 | timestamp[3];
+    uint32_t fraction = (uint32_t)timestamp[4] << 24 | (uint32_t)timestamp[5] << 16
+        | (uint32_t)timestamp[6] << 8 | timestamp[7];
+
+    int64_t unixSeconds = (int64_t)seconds - NTP_UNIX_OFFSET;
+    if ((seconds & 0x80000000UL) == 0) {
+        unixSeconds += 0x100000000LL;
+    }
+    return unixSeconds * 1000000LL + (int64_t)(((uint64_t)fraction * 1000000ULL) >> 32);
+}
+
+ntp_result_t ntpEvaluate(const ntp_exchange_t& exchange)
+{
+    ntp_result_t result;
+    uint32_t roundTripMicros = (exchange.receiveCycles - exchange.sendCycles) / exchange.cyclesPerMicro;
+    int32_t processingMicros = (int32_t)(exchange.serverTransmitMicros - exchange.serverReceiveMicros);
+    result.delayMicros = (int32_t)roundTripMicros - processingMicros;
+    if (result.delayMicros < 0) {
+        result.delayMicros = 0;
+    }
+    result.ageMicros = (exchange.readCycles - exchange.receiveCycles) / exchange.cyclesPerMicro;
+
+    // Server time at arrival is T3 plus the return path, then the wait
+    result.unixMicros = exchange.serverTransmitMicros + result.delayMicros / 2 + result.ageMicros;
+    return result;
+}
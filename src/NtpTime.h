@@ -0,0 +1,41 @@
+/**
+ * CTW Nebenuhr - NTP timestamp arithmetic
+ *
+ * Plain functions over the four timestamps of an NTP exchange, kept apart
+ * from CallbackNtpClock so they can be tested on the host. The local ones
+ * (request sent, reply received, reply read) are CPU cycle counts, the
+ * server ones come from the packet.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t sendCycles; // T1, request handed to lwIP
+    uint32_t receiveCycles; // T4, reply seen in the receive callback
+    uint32_t readCycles; // Reply read from loop(), T4 plus however long it waited
+    uint32_t cyclesPerMicro; // CPU clock in MHz
+    int64_t serverReceiveMicros; // T2, unix micros
+    int64_t serverTransmitMicros; // T3, unix micros
+} ntp_exchange_t;
+
+typedef struct {
+    int64_t unixMicros; // Server time at readCycles
+    int32_t delayMicros; // Round trip without server processing time
+    uint32_t ageMicros; // Time the reply waited to be read
+} ntp_result_t;
+
+/**
+ * Convert a 64 bit NTP timestamp (seconds + binary fraction, big endian) to
+ * unix micros. Timestamps with the MSB cleared are taken from era 1 (after
+ * 2036-02-07).
+ */
+int64_t ntpToUnixMicros(const uint8_t* timestamp);
+
+/**
+ * Time at the moment the reply is read, assuming a symmetric network path.
+ * Unsigned cycle differences handle a counter wrap in between.
+ */
+ntp_result_t ntpEvaluate(const ntp_exchange_t& exchange);
@@ -0,0 +1,131 @@
+/**
+ * CTW Nebenuhr - Rendering of compiled HTML templates
+ *
+ * tools/html_template.py turns html/<name>.html into a table of PROGMEM
+ * fragments, each followed by a typed slot. Rendering walks the table, copies
+ * the fragments from flash and lets a slot writer print the dynamic values
+ * straight into the output, without building String temporaries. Rendering
+ * into a LengthCounter first gives the exact Content-Length.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+
+typedef struct {
+    PGM_P text; // Static markup in flash
+    uint16_t length; // Length of the markup, without terminating NUL
+    uint8_t slot; // Slot following the markup, 0 = none
+} PageFragment;
+
+/**
+ * Walk a compiled template, writing fragments and slots to out
+ */
+template <typename Slot>
+void renderPage(Print& out, const PageFragment* fragments, size_t count, void (*writeSlot)(Print&, Slot))
+{
+    for (size_t i = 0; i < count; i++) {
+        PageFragment fragment;
+        memcpy_P(&fragment, &fragments[i], sizeof(fragment));
+        out.write_P(fragment.text, fragment.length);
+        if (fragment.slot != 0) {
+            writeSlot(out, (Slot)fragment.slot);
+        }
+    }
+}
+
+/**
+ * Print that only counts, for the Content-Length of a rendered page
+ */
+class LengthCounter : public Print {
+public:
+    void add(size_t length) { mLength += length; }
+
+    size_t write(uint8_t) override
+    {
+        mLength++;
+        return 1;
+    }
+    size_t write(const uint8_t*, size_t size) override
+    {
+        mLength += size;
+        return size;
+    }
+    size_t length() const { return mLength; }
+
+private:
+    size_t mLength = 0;
+};
+
+/**
+ * Buffered Print sending full packets to the current web client
+ * Works with the plain and the TLS flavour of the web server
+ */
+template <class Server>
+class ContentWriter : public Print {
+public:
+    static const size_t kBufferSize = 512;
+
+    explicit ContentWriter(Server& server)
+        : mServer(server)
+    {
+    }
+    ~ContentWriter() { flush(); }
+
+    size_t write(uint8_t c) override
+    {
+        if (mFill == kBufferSize) {
+            flush();
+        }
+        mBuffer[mFill++] = c;
+        return 1;
+    }
+    size_t write(const uint8_t* data, size_t size) override
+    {
+        size_t written = size;
+        while (size > 0) {
+            if (mFill == kBufferSize) {
+                flush();
+            }
+            size_t chunk = min(size, kBufferSize - mFill);
+            memcpy(mBuffer + mFill, data, chunk);
+            mFill += chunk;
+            data += chunk;
+            size -= chunk;
+        }
+        return written;
+    }
+    void flush() override
+    {
+        if (mFill > 0) {
+            mServer.sendContent(mBuffer, mFill);
+            mFill = 0;
+        }
+    }
+
+private:
+    Server& mServer;
+    char mBuffer[kBufferSize];
+    size_t mFill = 0;
+};
+
+/**
+ * Exact length of a rendered page
+ * Fragment lengths come from the table, only the slots are rendered
+ */
+template <typename Slot>
+size_t measurePage(const PageFragment* fragments, size_t count, void (*writeSlot)(Print&, Slot))
+{
+    LengthCounter counter;
+    for (size_t i = 0; i < count; i++) {
+        PageFragment fragment;
+        memcpy_P(&fragment, &fragments[i], sizeof(fragment));
+        counter.add(fragment.length);
+        if (fragment.slot != 0) {
+            writeSlot(counter, (Slot)fragment.slot);
+        }
+    }
+    return counter.length();
+}
@@ -0,0 +1,177 @@
+/**
+ * CTW Nebenuhr - WiFi provisioning
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "Provisioning.h"
+
+#include <ESP8266WiFi.h>
+
+Provisioning::Provisioning(ESP8266WebServer& server, const char* apName, SaveCallback onSave)
+    : mServer(server)
+    , mApName(apName)
+    , mOnSave(onSave)
+{
+}
+
+void Provisioning::setup()
+{
+    // Credentials live in our own config, keep the SDK from writing its copy
+    // or connecting with an old one on its own
+    WiFi.persistent(false);
+    WiFi.setAutoConnect(false);
+    WiFi.setAutoReconnect(true);
+
+    mServer.on("/wifi", HTTP_GET, [this]() { handleForm(); });
+    mServer.on("/wifi", HTTP_POST, [this]() { handleSave(); });
+}
+
+void Provisioning::begin(const char* ssid, const char* password)
+{
+    if (ssid[0] == '\0') {
+        startPortal();
+        return;
+    }
+    WiFi.mode(mPortalActive ? WIFI_AP_STA : WIFI_STA);
+    WiFi.begin(ssid, password);
+    mConnecting = true;
+    mConnectedMillis = 0;
+    mConnectStartMillis = millis();
+}
+
+void Provisioning::eraseSdkCredentials()
+{
+    // Only a persistent disconnect clears the stored station config
+    WiFi.persistent(true);
+    WiFi.disconnect(true);
+    WiFi.persistent(false);
+}
+
+void Provisioning::startPortal()
+{
+    if (mPortalActive) {
+        return;
+    }
+    // Keep the station part enabled, so known credentials are still retried
+    WiFi.mode(WIFI_AP_STA);
+    WiFi.softAP(mApName);
+    mDnsServer.start(kDnsPort, "*", WiFi.softAPIP());
+    mPortalActive = true;
+    mConnectedMillis = 0;
+}
+
+void Provisioning::stopPortal()
+{
+    mDnsServer.stop();
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+    mPortalActive = false;
+}
+
+bool Provisioning::isConnected() const
+{
+    return WiFi.status() == WL_CONNECTED;
+}
+
+void Provisioning::loop()
+{
+    unsigned long now = millis();
+    if (isConnected()) {
+        mConnecting = false;
+        if (mPortalActive) {
+            if (mConnectedMillis == 0) {
+                mConnectedMillis = now;
+            } else if (now - mConnectedMillis > kPortalLingerMillis) {
+                stopPortal();
+            }
+        }
+    } else if (mConnecting && now - mConnectStartMillis > kConnectTimeoutMillis) {
+        mConnecting = false;
+        startPortal();
+    }
+
+    if (mPortalActive) {
+        mDnsServer.processNextRequest();
+    }
+}
+
+bool Provisioning::handleCaptivePortal()
+{
+    if (!mPortalActive) {
+        return false;
+    }
+    mServer.sendHeader(F("Location"), String(F("http://")) + WiFi.softAPIP().toString() + F("/wifi"));
+    mServer.send(302, F("text/plain"), "");
+    return true;
+}
+
+/**
+ * Escape text for use inside an HTML attribute
+ */
+static String htmlEscape(const String& text)
+{
+    String escaped;
+    escaped.reserve(text.length());
+    for (size_t i = 0; i < text.length(); i++) {
+        char c = text[i];
+        if (c == '&') {
+            escaped += F("&amp;");
+        } else if (c == '<') {
+            escaped += F("&lt;");
+        } else if (c == '>') {
+            escaped += F("&gt;");
+        } else if (c == '\'') {
+            escaped += F("&#39;");
+        } else if (c == '"') {
+            escaped += F("&quot;");
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+bool Provisioning::rejectUnlessPortal()
+{
+    if (mPortalActive) {
+        return false;
+    }
+    // Credentials can only be changed while the portal is open, not by
+    // anyone on the network the clock is connected to
+    mServer.send(404, F("text/plain"), F("404: Not found"));
+    return true;
+}
+
+void Provisioning::handleForm()
+{
+    if (rejectUnlessPortal()) {
+        return;
+    }
+    String webpage = F("<!DOCTYPE html><html><head><title>CTW Nebenuhr</title>"
+                       "<meta name='viewport' content='width=device-width,initial-scale=1'>"
+                       "<style>body{font-family:sans-serif;margin:2em;color:darkslategray;background-color:#EEE}"
+                       "input{font-size:18pt;width:100%;margin-bottom:1em}</style></head><body>"
+                       "<h1>WLAN</h1><form action='/wifi' method='POST'>"
+                       "SSID:<input name='ssid' value='");
+    webpage += htmlEscape(WiFi.SSID());
+    webpage += F("'>Passwort:<input name='password' type='password'>"
+                 "<input type='submit' value='Verbinden'></form></body></html>\n");
+    mServer.send(200, F("text/html; charset=utf-8"), webpage);
+}
+
+void Provisioning::handleSave()
+{
+    if (rejectUnlessPortal()) {
+        return;
+    }
+    String ssid = mServer.arg("ssid");
+    String password = mServer.arg("password");
+    if (ssid.length() == 0 || ssid.length() > 32 || password.length() > 64) {
+        mServer.send(400, F("text/plain"), F("Invalid credentials"));
+        return;
+    }
+
+    mOnSave(ssid.c_str(), password.c_str());
+    mServer.send(200, F("text/plain; charset=utf-8"), String(F("Verbinde mit ")) + ssid);
+    begin(ssid.c_str(), password.c_str());
+}
@@ -0,0 +1,77 @@
+/**
+ * CTW Nebenuhr - WiFi provisioning
+ *
+ * A small replacement for WiFiManager. It reuses the firmware's web server
+ * and leaves persistence of the credentials to the caller. SoftAP and captive
+ * DNS only run while no working credentials are known. Nothing in here
+ * blocks: the connection is attempted in the background while setup()
+ * continues, and the portal is opened when the attempt times out.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <DNSServer.h>
+#include <ESP8266WebServer.h>
+
+#include <functional>
+
+class Provisioning {
+public:
+    typedef std::function<void(const char* ssid, const char* password)> SaveCallback;
+
+    static const unsigned long kConnectTimeoutMillis = 20000;
+    // Keep the AP up a bit after connecting, so the browser gets its answer
+    static const unsigned long kPortalLingerMillis = 5000;
+    static const uint8_t kDnsPort = 53;
+
+    Provisioning(ESP8266WebServer& server, const char* apName, SaveCallback onSave);
+
+    /** Register the /wifi handlers (answered only while the portal is active), call before server.begin(). */
+    void setup();
+
+    /**
+     * Start connecting with the stored credentials.
+     * An empty SSID opens the portal right away.
+     */
+    void begin(const char* ssid, const char* password);
+
+    /** Forget the current credentials and open the portal. */
+    void startPortal();
+
+    /**
+     * Drop the connection and clear the station config the SDK keeps in
+     * flash, so the caller's copy is the only one left.
+     */
+    void eraseSdkCredentials();
+
+    void loop();
+
+    bool isConnected() const;
+    bool isPortalActive() const { return mPortalActive; }
+
+    /**
+     * Redirect unknown requests to the setup page while the portal is
+     * active, so captive portal detection of phones pops it up.
+     * Returns false if the request was not handled.
+     */
+    bool handleCaptivePortal();
+
+private:
+    /** Answer 404 and return true while the portal is closed. */
+    bool rejectUnlessPortal();
+    void handleForm();
+    void handleSave();
+    void stopPortal();
+
+    ESP8266WebServer& mServer;
+    const char* const mApName;
+    SaveCallback mOnSave;
+    DNSServer mDnsServer;
+
+    bool mPortalActive = false;
+    bool mConnecting = false;
+    unsigned long mConnectStartMillis = 0;
+    unsigned long mConnectedMillis = 0;
+};
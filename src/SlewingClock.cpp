@@ -0,0 +1,162 @@
+/**
+ * CTW Nebenuhr - System clock with slew-based correction
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "SlewingClock.h"
+
+using ace_time::Epoch;
+
+SlewingClock::SlewingClock(CallbackNtpClock* referenceClock,
+    uint16_t syncPeriodSeconds,
+    uint16_t initialSyncPeriodSeconds)
+    : mReferenceClock(referenceClock)
+    , mSyncPeriodSeconds(syncPeriodSeconds)
+    , mInitialSyncPeriodSeconds(initialSyncPeriodSeconds)
+{
+}
+
+void SlewingClock::setJitter(uint32_t seed, uint16_t firstSyncMaxDelayMillis)
+{
+    // xorshift32 must not start at zero
+    mRandomState = seed ? seed : 1;
+    mFirstSyncMaxDelayMillis = firstSyncMaxDelayMillis;
+}
+
+uint32_t SlewingClock::jitter(uint32_t periodMillis, uint8_t percent)
+{
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    uint32_t range = periodMillis / 100 * percent;
+    if (range == 0) {
+        return periodMillis;
+    }
+    return periodMillis - range + mRandomState % (2 * range + 1);
+}
+
+void SlewingClock::setup()
+{
+    mBaseMillis = millis();
+}
+
+int32_t SlewingClock::slewFor(uint32_t elapsedMillis) const
+{
+    if (mSlewRemainingMillis == 0) {
+        return 0;
+    }
+    int32_t maxSlew = (int32_t)(((uint64_t)elapsedMillis * kSlewPpm) / 1000000UL);
+    if (mSlewRemainingMillis > 0) {
+        return mSlewRemainingMillis < maxSlew ? mSlewRemainingMillis : maxSlew;
+    }
+    return -mSlewRemainingMillis < maxSlew ? mSlewRemainingMillis : -maxSlew;
+}
+
+int64_t SlewingClock::getUnixMillis() const
+{
+    uint32_t elapsed = millis() - mBaseMillis;
+    return mBaseUnixMillis + elapsed + slewFor(elapsed);
+}
+
+void SlewingClock::keepAlive()
+{
+    unsigned long now = millis();
+    uint32_t elapsed = now - mBaseMillis;
+    // Below one slew increment folding would lose the fraction, so wait
+    if (elapsed < 1000000UL / kSlewPpm) {
+        return;
+    }
+    int32_t slew = slewFor(elapsed);
+    mBaseUnixMillis += elapsed + slew;
+    mSlewRemainingMillis -= slew;
+    mBaseMillis = now;
+}
+
+acetime_t SlewingClock::getNow() const
+{
+    if (!mIsInit) {
+        return kInvalidSeconds;
+    }
+    int64_t unixSeconds = getUnixMillis() / 1000;
+    return (acetime_t)(unixSeconds - Epoch::secondsToCurrentEpochFromUnixEpoch64());
+}
+
+void SlewingClock::setNow(acetime_t epochSeconds)
+{
+    if (epochSeconds == kInvalidSeconds) {
+        return;
+    }
+    syncTo(((int64_t)epochSeconds + Epoch::secondsToCurrentEpochFromUnixEpoch64()) * 1000);
+}
+
+void SlewingClock::syncTo(int64_t referenceUnixMillis)
+{
+    keepAlive();
+    unsigned long now = millis();
+    int64_t offset = referenceUnixMillis - getUnixMillis();
+    bool holdover = now - mLastSyncMillis
+        > (unsigned long)mSyncPeriodSeconds * 1000UL * kHoldoverSyncPeriods;
+
+    if (!mIsInit || holdover || offset > kMaxSlewMillis || offset < -kMaxSlewMillis) {
+        // Step: first sync, stale holdover or too far off to slew
+        mBaseUnixMillis = referenceUnixMillis;
+        mBaseMillis = now;
+        mSlewRemainingMillis = 0;
+        mStepCount++;
+    } else {
+        // Slew: the new offset already contains what was left of the last one
+        mSlewRemainingMillis = (int32_t)offset;
+        mSlewCount++;
+    }
+
+    mLastOffsetMillis = offset > INT32_MAX ? INT32_MAX : offset < INT32_MIN ? INT32_MIN : (int32_t)offset;
+    mLastSyncMillis = now;
+    mIsInit = true;
+}
+
+void SlewingClock::loop()
+{
+    keepAlive();
+
+    unsigned long now = millis();
+    if (mRequestPending) {
+        if (mReferenceClock->isResponseReady()) {
+            mRequestPending = false;
+            syncTo(mReferenceClock->readResponseMillis());
+            mReferenceSyncCount++;
+            mLastReferenceSyncMillis = now;
+            mRetryCount = 0;
+            mNextRequestMillis = now + jitter(mSyncPeriodSeconds * 1000UL, kSyncJitterPercent);
+        } else if (now - mRequestStartMillis >= CallbackNtpClock::kRequestTimeoutMillis) {
+            // Timed out - exponential backoff with jitter, up to the regular period
+            mRequestPending = false;
+            uint32_t retrySeconds = mRetryCount < 12
+                ? min((uint32_t)mInitialSyncPeriodSeconds << mRetryCount, (uint32_t)mSyncPeriodSeconds)
+                : mSyncPeriodSeconds;
+            mRetryCount++;
+            mNextRequestMillis = now + jitter(retrySeconds * 1000UL, kRetryJitterPercent);
+        }
+        return;
+    }
+
+    // Offline time does not count as failed attempts, no backoff for it
+    if (!mReferenceClock->canSendRequest()) {
+        return;
+    }
+    if (!mFirstRequestScheduled) {
+        // Clocks sharing a power supply get their network at about the same
+        // moment, not at boot: spread the first requests from there
+        mFirstRequestScheduled = true;
+        mNextRequestMillis = now + mRandomState % (mFirstSyncMaxDelayMillis + 1UL);
+    }
+    if (mRequestGate && !mRequestGate()) {
+        return;
+    }
+
+    if ((long)(now - mNextRequestMillis) >= 0) {
+        mRequestStartMillis = now;
+        mRequestPending = true;
+        mRequestCount++;
+        mReferenceClock->sendRequest();
+    }
+}
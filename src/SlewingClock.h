@@ -0,0 +1,124 @@
+/**
+ * CTW Nebenuhr - System clock with slew-based correction
+ *
+ * Replaces AceTimeClock's SystemClockLoop, which jumps the epoch by the full
+ * measured offset on every sync. A jump can skip or repeat the second right
+ * where setCurrentTime() checks for second 59, so a minute pulse may be given
+ * early, late or twice. This clock keeps millisecond resolution and applies
+ * small corrections by running slightly fast or slow (at most kSlewPpm) until
+ * the offset is consumed. It only steps on the first sync, after a holdover
+ * period without successful syncs, or when the offset exceeds kMaxSlewMillis.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <AceTimeClock.h>
+
+#include "CallbackNtpClock.h"
+
+class SlewingClock : public ace_time::clock::Clock {
+public:
+    typedef bool (*RequestGate)();
+
+    // Rate adjustment while slewing, 5000 ppm = 5 ms per second
+    static const uint32_t kSlewPpm = 5000;
+    // Larger offsets are stepped, this one is corrected within 200 s
+    static const int32_t kMaxSlewMillis = 1000;
+    // Without a successful sync for this many sync periods the clock steps
+    static const uint8_t kHoldoverSyncPeriods = 3;
+    // Regular sync period varies by +-10 %, retry delays by +-25 %
+    static const uint8_t kSyncJitterPercent = 10;
+    static const uint8_t kRetryJitterPercent = 25;
+
+    SlewingClock(CallbackNtpClock* referenceClock,
+        uint16_t syncPeriodSeconds = 3600,
+        uint16_t initialSyncPeriodSeconds = 5);
+
+    /**
+     * Spread requests of many clocks booting at the same time, e.g. after
+     * a power outage of a whole station. The seed should be unique per
+     * device (derived from the MAC address). The first request is delayed by
+     * up to firstSyncMaxDelayMillis after the network comes up, all later
+     * ones are jittered.
+     * Call before setup().
+     */
+    void setJitter(uint32_t seed, uint16_t firstSyncMaxDelayMillis);
+
+    void setup();
+
+    /**
+     * Defer sync requests while the gate returns false, e.g. during a coil
+     * pulse. A deferred request is sent as soon as the gate opens.
+     */
+    void setRequestGate(RequestGate gate) { mRequestGate = gate; }
+
+    /** Drive the sync state machine, call as often as possible. */
+    void loop();
+
+    acetime_t getNow() const override;
+    void setNow(acetime_t epochSeconds) override;
+
+    /**
+     * Sync to a local reference, e.g. a battery-backed RTC at boot or while
+     * NTP is unreachable. Stepped or slewed like an NTP response.
+     */
+    void setUnixMillis(int64_t unixMillis) { syncTo(unixMillis); }
+
+    /** Current unix time in milliseconds, monotonic while slewing. */
+    int64_t getUnixMillis() const;
+
+    bool isInit() const { return mIsInit; }
+    bool isRequestPending() const { return mRequestPending; }
+
+    int32_t getLastOffsetMillis() const { return mLastOffsetMillis; }
+    int32_t getPendingSlewMillis() const { return mSlewRemainingMillis; }
+    uint16_t getStepCount() const { return mStepCount; }
+    uint16_t getSlewCount() const { return mSlewCount; }
+    uint32_t getRequestCount() const { return mRequestCount; }
+    unsigned long getMillisSinceSync() const { return millis() - mLastSyncMillis; }
+
+    /** Syncs from the NTP reference clock, not counting setNow()/setUnixMillis(). */
+    uint32_t getReferenceSyncCount() const { return mReferenceSyncCount; }
+    unsigned long getMillisSinceReferenceSync() const { return millis() - mLastReferenceSyncMillis; }
+
+private:
+    /** Slew correction applied over elapsedMillis, limited to what is left. */
+    int32_t slewFor(uint32_t elapsedMillis) const;
+
+    /** Fold elapsed time and applied slew into the base. */
+    void keepAlive();
+
+    void syncTo(int64_t referenceUnixMillis);
+
+    /** Pseudo random delay of periodMillis +- percent, sequence depends on the seed. */
+    uint32_t jitter(uint32_t periodMillis, uint8_t percent);
+
+    CallbackNtpClock* const mReferenceClock;
+    RequestGate mRequestGate = nullptr;
+    const uint16_t mSyncPeriodSeconds;
+    const uint16_t mInitialSyncPeriodSeconds;
+
+    int64_t mBaseUnixMillis = 0;
+    unsigned long mBaseMillis = 0;
+    int32_t mSlewRemainingMillis = 0;
+    bool mIsInit = false;
+
+    bool mRequestPending = false;
+    unsigned long mRequestStartMillis = 0;
+    unsigned long mNextRequestMillis = 0;
+    bool mFirstRequestScheduled = false;
+    unsigned long mLastSyncMillis = 0;
+    uint8_t mRetryCount = 0;
+
+    uint32_t mRandomState = 1;
+    uint16_t mFirstSyncMaxDelayMillis = 0;
+
+    int32_t mLastOffsetMillis = 0;
+    uint16_t mStepCount = 0;
+    uint16_t mSlewCount = 0;
+    uint32_t mRequestCount = 0;
+    uint32_t mReferenceSyncCount = 0;
+    unsigned long mLastReferenceSyncMillis = 0;
+};
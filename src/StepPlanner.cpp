@@ -0,0 +1,114 @@
+/**
+ * CTW Nebenuhr - Stepping policies for the physical clock
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "StepPlanner.h"
+
+static const int16_t MINUTES_PER_DAY = 1440;
+
+const char* stepActionName(StepAction action)
+{
+    switch (action) {
+    case StepAction::Hold:
+        return "hold";
+    case StepAction::Advance:
+        return "advance";
+    case StepAction::Wrap:
+        return "wrap";
+    }
+    return "?";
+}
+
+uint32_t StepPlanner::predictConvergenceSeconds(int16_t displayed, int16_t target, uint8_t second) const
+{
+    static const uint32_t kHorizonSeconds = 2 * 86400UL;
+    uint32_t elapsed = 0;
+    while (elapsed < kHorizonSeconds) {
+        if (displayed == target) {
+            return elapsed;
+        }
+        switch (plan(displayed, target)) {
+        case StepAction::Hold:
+            // Nothing changes before the target moves on, skip ahead
+            elapsed += 60 - second;
+            second = 0;
+            target = (target + 1) % MINUTES_PER_DAY;
+            continue;
+        case StepAction::Advance:
+            displayed++;
+            if (displayed >= MINUTES_PER_DAY) {
+                displayed -= MINUTES_PER_DAY;
+            }
+            break;
+        case StepAction::Wrap:
+            displayed -= MINUTES_PER_DAY;
+            break;
+        }
+        elapsed++;
+        if (++second == 60) {
+            second = 0;
+            target = (target + 1) % MINUTES_PER_DAY;
+        }
+    }
+    return kNever;
+}
+
+StepAction ThresholdPlanner::plan(int16_t displayed, int16_t target) const
+{
+    if (displayed == target) {
+        return StepAction::Hold;
+    }
+    if (displayed < target) {
+        return StepAction::Advance;
+    }
+    if (displayed > target + mWaitMinutes) {
+        return StepAction::Wrap;
+    }
+    return StepAction::Hold;
+}
+
+StepAction FastestPlanner::plan(int16_t displayed, int16_t target) const
+{
+    if (displayed == target) {
+        return StepAction::Hold;
+    }
+    if (displayed < target) {
+        return StepAction::Advance;
+    }
+    // Catching up gains 59 minutes per hour on the moving target
+    uint32_t ahead = displayed - target;
+    uint32_t waitSeconds = ahead * 60;
+    uint32_t wrapSeconds = (MINUTES_PER_DAY - ahead) * 60 / 59;
+    return waitSeconds <= wrapSeconds ? StepAction::Hold : StepAction::Wrap;
+}
+
+StepAction PlannerShadow::decide(int16_t displayed, int16_t target, uint8_t second)
+{
+    StepAction action = mActive.plan(displayed, target);
+    StepAction candidate = mShadow.plan(displayed, target);
+    mDecisions++;
+    mStarted = false;
+    if (action == candidate) {
+        mDisagreeing = false;
+        return action;
+    }
+
+    mDisagreements++;
+    if (!mDisagreeing) {
+        // Predictions only once per run, they are not free
+        mDisagreeing = true;
+        mStarted = true;
+        mEpisodes++;
+        mLastActiveAction = action;
+        mLastShadowAction = candidate;
+        mLastActiveSeconds = mActive.predictConvergenceSeconds(displayed, target, second);
+        mLastShadowSeconds = mShadow.predictConvergenceSeconds(displayed, target, second);
+        if (mLastShadowSeconds < mLastActiveSeconds) {
+            mShadowFaster++;
+        } else if (mLastShadowSeconds > mLastActiveSeconds) {
+            mShadowSlower++;
+        }
+    }
+    return action;
+}
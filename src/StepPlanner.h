@@ -0,0 +1,125 @@
+/**
+ * CTW Nebenuhr - Stepping policies for the physical clock
+ *
+ * A planner decides once per second whether the movement holds, advances by
+ * one minute or wraps the displayed time back by a day to catch up the long
+ * way round. The rule that has been driving the clock is ThresholdPlanner(10).
+ *
+ * PlannerShadow runs a candidate planner alongside the active one on the same
+ * inputs without driving the outputs, and records where they disagree with
+ * the predicted convergence time of both. New policies can so be validated on
+ * real devices, through DST changes and outages, before driving the motor.
+ *
+ * Plain C++ without Arduino dependencies, times are in minutes from midnight.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <stdint.h>
+
+enum class StepAction : uint8_t {
+    Hold, // Leave the movement alone
+    Advance, // Give one minute pulse
+    Wrap, // Displayed time minus one day, catch up by advancing
+};
+
+const char* stepActionName(StepAction action);
+
+class StepPlanner {
+public:
+    // Convergence prediction gives up after two days
+    static const uint32_t kNever = UINT32_MAX;
+
+    virtual ~StepPlanner() { }
+
+    /** Next action for the displayed and the target time. */
+    virtual StepAction plan(int16_t displayed, int16_t target) const = 0;
+
+    virtual const char* name() const = 0;
+
+    /**
+     * Seconds until the dial shows the target when following this planner
+     * from now on, one decision per second, the target moving on at the
+     * minute. Returns kNever if it does not converge within two days.
+     */
+    uint32_t predictConvergenceSeconds(int16_t displayed, int16_t target, uint8_t second) const;
+};
+
+/**
+ * Advance while behind, wait while at most waitMinutes ahead, wrap otherwise
+ */
+class ThresholdPlanner : public StepPlanner {
+public:
+    explicit ThresholdPlanner(int16_t waitMinutes)
+        : mWaitMinutes(waitMinutes)
+    {
+    }
+
+    StepAction plan(int16_t displayed, int16_t target) const override;
+    const char* name() const override { return "threshold"; }
+
+private:
+    int16_t mWaitMinutes;
+};
+
+/**
+ * Wait or wrap, whichever shows the right time sooner
+ * Waiting takes a minute per minute ahead, catching up one step per second.
+ */
+class FastestPlanner : public StepPlanner {
+public:
+    StepAction plan(int16_t displayed, int16_t target) const override;
+    const char* name() const override { return "fastest"; }
+};
+
+/**
+ * Active planner with a shadow candidate evaluated on the same inputs
+ */
+class PlannerShadow {
+public:
+    PlannerShadow(const StepPlanner& active, const StepPlanner& shadow)
+        : mActive(active)
+        , mShadow(shadow)
+    {
+    }
+
+    /** Decide with the active planner, comparing with the shadow. */
+    StepAction decide(int16_t displayed, int16_t target, uint8_t second);
+
+    /** True if the last decision started a run of disagreements. */
+    bool disagreementStarted() const { return mStarted; }
+
+    const StepPlanner& active() const { return mActive; }
+    const StepPlanner& shadow() const { return mShadow; }
+
+    uint32_t getDecisionCount() const { return mDecisions; }
+    uint32_t getDisagreementCount() const { return mDisagreements; }
+    uint32_t getEpisodeCount() const { return mEpisodes; }
+    uint32_t getShadowFasterCount() const { return mShadowFaster; }
+    uint32_t getShadowSlowerCount() const { return mShadowSlower; }
+
+    // First decision of the last run of disagreements
+    StepAction getLastActiveAction() const { return mLastActiveAction; }
+    StepAction getLastShadowAction() const { return mLastShadowAction; }
+    uint32_t getLastActiveSeconds() const { return mLastActiveSeconds; }
+    uint32_t getLastShadowSeconds() const { return mLastShadowSeconds; }
+
+private:
+    const StepPlanner& mActive;
+    const StepPlanner& mShadow;
+
+    bool mDisagreeing = false;
+    bool mStarted = false;
+
+    uint32_t mDecisions = 0;
+    uint32_t mDisagreements = 0;
+    uint32_t mEpisodes = 0;
+    uint32_t mShadowFaster = 0;
+    uint32_t mShadowSlower = 0;
+
+    StepAction mLastActiveAction = StepAction::Hold;
+    StepAction mLastShadowAction = StepAction::Hold;
+    uint32_t mLastActiveSeconds = 0;
+    uint32_t mLastShadowSeconds = 0;
+};
@@ -0,0 +1,155 @@
+/**
+ * CTW Nebenuhr - Timezone database in a separately updatable flash partition
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "TzPartition.h"
+
+// Filesystem region from the linker script, mapped at 0x40200000 + offset
+extern "C" uint32_t _FS_start;
+extern "C" uint32_t _FS_end;
+
+static const uint32_t FLASH_MAP_ADDRESS = 0x40200000;
+
+uint32_t TzPartition::mappedAddress() const
+{
+    return (uint32_t)&_FS_start;
+}
+
+uint32_t TzPartition::flashAddress() const
+{
+    return mappedAddress() - FLASH_MAP_ADDRESS;
+}
+
+size_t TzPartition::capacity() const
+{
+    return (uint32_t)&_FS_end - (uint32_t)&_FS_start;
+}
+
+uint32_t TzPartition::crc32(uint32_t crc, const uint8_t* data, size_t length)
+{
+    crc = ~crc;
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+bool TzPartition::begin()
+{
+    mValid = false;
+    if (capacity() < sizeof(mHeader)
+        || !ESP.flashRead(flashAddress(), (uint32_t*)&mHeader, sizeof(mHeader))) {
+        return false;
+    }
+
+    if (mHeader.magicNumber != TZDB_MAGIC_NUMBER
+        || mHeader.formatVersion != TZDB_FORMAT_VERSION
+        || mHeader.aceTimeVersion != ACE_TIME_VERSION
+        || mHeader.baseAddress != mappedAddress()
+        || mHeader.dataLength > capacity() - sizeof(mHeader)
+        || mHeader.registryOffset < sizeof(mHeader)
+        || mHeader.registryOffset + mHeader.registrySize * sizeof(void*) > sizeof(mHeader) + mHeader.dataLength) {
+        return false;
+    }
+    mHeader.tzVersion[sizeof(mHeader.tzVersion) - 1] = '\0';
+
+    // Checksum in small pieces, the data stays in flash
+    uint32_t buffer[64];
+    uint32_t crc = 0;
+    for (uint32_t offset = 0; offset < mHeader.dataLength; offset += sizeof(buffer)) {
+        size_t length = min((size_t)(mHeader.dataLength - offset), sizeof(buffer));
+        // flashRead needs 4 byte multiples, the tail is ignored by crc32()
+        if (!ESP.flashRead(flashAddress() + sizeof(mHeader) + offset, buffer, (length + 3) & ~3)) {
+            return false;
+        }
+        crc = crc32(crc, (const uint8_t*)buffer, length);
+        yield();
+    }
+
+    mValid = crc == mHeader.crc32;
+    return mValid;
+}
+
+const ace_time::extended::ZoneInfo* const* TzPartition::registry() const
+{
+    return (const ace_time::extended::ZoneInfo* const*)(mappedAddress() + mHeader.registryOffset);
+}
+
+bool TzPartition::beginUpdate()
+{
+    abortUpdate();
+    mValid = false;
+    mSectorErases++;
+    if (!ESP.flashEraseSector(flashAddress() / kSectorSize)) {
+        return false;
+    }
+    mSectorBuffer = (uint8_t*)new uint32_t[kSectorSize / sizeof(uint32_t)];
+    return mSectorBuffer != nullptr;
+}
+
+bool TzPartition::flushSector()
+{
+    if (mSectorFill == 0) {
+        return true;
+    }
+    memset(mSectorBuffer + mSectorFill, 0xff, kSectorSize - mSectorFill);
+    uint32_t address = flashAddress() + mWritten;
+    // The header sector was already erased by beginUpdate()
+    if (mWritten > 0) {
+        mSectorErases++;
+        if (!ESP.flashEraseSector(address / kSectorSize)) {
+            return false;
+        }
+    }
+    if (!ESP.flashWrite(address, (uint32_t*)mSectorBuffer, kSectorSize)) {
+        return false;
+    }
+    mWritten += kSectorSize;
+    mSectorFill = 0;
+    return true;
+}
+
+bool TzPartition::writeUpdate(const uint8_t* data, size_t length)
+{
+    if (!mSectorBuffer) {
+        return false;
+    }
+    while (length > 0) {
+        if (mWritten + mSectorFill + length > capacity()) {
+            abortUpdate();
+            return false;
+        }
+        size_t chunk = min(length, kSectorSize - mSectorFill);
+        memcpy(mSectorBuffer + mSectorFill, data, chunk);
+        mSectorFill += chunk;
+        data += chunk;
+        length -= chunk;
+        if (mSectorFill == kSectorSize && !flushSector()) {
+            abortUpdate();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TzPartition::endUpdate()
+{
+    if (!mSectorBuffer) {
+        return false;
+    }
+    bool written = flushSector();
+    abortUpdate();
+    return written && begin();
+}
+
+void TzPartition::abortUpdate()
+{
+    delete[] (uint32_t*)mSectorBuffer;
+    mSectorBuffer = nullptr;
+    mSectorFill = 0;
+    mWritten = 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * CTW Nebenuhr - Timezone database in a separately updatable flash partition
+ *
+ * The compiled-in zonedbx registry can only be changed with a full firmware
+ * update. This reads an AceTime zone registry from the flash region the
+ * linker script reserves for a filesystem (unused by this firmware). The
+ * region is memory-mapped, so the zone processor reads the data in place,
+ * just like PROGMEM data, without copying it into RAM. The built-in
+ * registry stays as fallback if the partition is empty or invalid.
+ *
+ * Layout, little endian, all offsets relative to the partition start:
+ *
+ *   TzPartitionHeader   magic, format, AceTime version, tz version, crc
+ *   data                AceTime extended::ZoneInfo structures and the
+ *                       registry table, pointers relocated to baseAddress
+ *
+ * The crc32 (IEEE 802.3) covers dataLength bytes following the header.
+ * tools/tzdb_image.py builds such an image from the AceTime sources.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <AceTime.h>
+
+#define TZDB_MAGIC_NUMBER 0x42445a54 // "TZDB"
+#define TZDB_FORMAT_VERSION 1
+
+typedef struct {
+    uint32_t magicNumber; // TZDB_MAGIC_NUMBER
+    uint16_t formatVersion; // TZDB_FORMAT_VERSION
+    uint16_t registrySize; // Number of zones in the registry table
+    uint32_t aceTimeVersion; // ACE_TIME_VERSION the structures were built for
+    char tzVersion[8]; // IANA release, e.g. "2025b", NUL terminated
+    uint32_t baseAddress; // Mapped address the pointers were relocated to
+    uint32_t registryOffset; // Offset of the ZoneInfo* table
+    uint32_t dataLength; // Bytes following the header
+    uint32_t crc32; // Checksum over the data
+} tz_partition_header_t;
+
+class TzPartition {
+public:
+    static const size_t kSectorSize = 4096;
+
+    /** Validate the partition, returns true if the registry can be used. */
+    bool begin();
+
+    bool isValid() const { return mValid; }
+    const tz_partition_header_t& header() const { return mHeader; }
+
+    uint16_t registrySize() const { return mHeader.registrySize; }
+    const ace_time::extended::ZoneInfo* const* registry() const;
+
+    size_t capacity() const;
+
+    /**
+     * Streaming update, fed with consecutive chunks of a partition image.
+     * The header sector is erased first, so an interrupted update leaves an
+     * invalid partition and the built-in registry is used after reboot.
+     */
+    bool beginUpdate();
+    bool writeUpdate(const uint8_t* data, size_t length);
+    bool endUpdate();
+    void abortUpdate();
+
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length);
+
+    /** Flash sectors erased by updates since boot. */
+    uint32_t sectorErases() const { return mSectorErases; }
+
+private:
+    uint32_t flashAddress() const;
+    uint32_t mappedAddress() const;
+    bool flushSector();
+
+    tz_partition_header_t mHeader;
+    bool mValid = false;
+
+    uint8_t* mSectorBuffer = nullptr;
+    size_t mSectorFill = 0;
+    size_t mWritten = 0;
+    uint32_t mSectorErases = 0;
+};
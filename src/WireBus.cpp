@@ -0,0 +1,34 @@
+/**
+ * CTW Nebenuhr - I2C register access via the Arduino Wire library
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "WireBus.h"
+
+#include <Wire.h>
+
+void WireBus::begin()
+{
+    Wire.begin();
+}
+
+bool WireBus::readRegisters(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length)
+{
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    if (Wire.endTransmission() != 0 || Wire.requestFrom(address, length) != length) {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        data[i] = Wire.read();
+    }
+    return true;
+}
+
+bool WireBus::writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length)
+{
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    Wire.write(data, length);
+    return Wire.endTransmission() == 0;
+}
@@ -0,0 +1,17 @@
+/**
+ * CTW Nebenuhr - I2C register access via the Arduino Wire library
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include "I2cBus.h"
+
+class WireBus : public I2cBus {
+public:
+    /** Start the bus on the default pins (SDA = D2, SCL = D1). */
+    void begin();
+
+    bool readRegisters(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length) override;
+    bool writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length) override;
+};
@@ -0,0 +1,62 @@
+/**
+ * CTW Nebenuhr - Zone list sorted by name, built in idle time
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include "ZoneIndexCache.h"
+
+using ace_time::ExtendedZone;
+using ace_time::ExtendedZoneManager;
+
+ZoneIndexCache::~ZoneIndexCache()
+{
+    delete[] mIndexes;
+}
+
+void ZoneIndexCache::reset(ExtendedZoneManager* manager)
+{
+    delete[] mIndexes;
+    mManager = manager;
+    mSize = manager->zoneRegistrySize();
+    mIndexes = new uint16_t[mSize];
+    mSorted = 0;
+}
+
+bool ZoneIndexCache::isReadyFor(const ExtendedZoneManager* manager) const
+{
+    return mManager == manager && mIndexes && mSorted == mSize;
+}
+
+void ZoneIndexCache::nameOf(uint16_t index, Print& printer) const
+{
+    ExtendedZone zone = mManager->getZoneForIndex(index);
+    zone.printNameTo(printer);
+}
+
+bool ZoneIndexCache::step()
+{
+    if (!mIndexes || mSorted >= mSize) {
+        return true;
+    }
+
+    // Binary insertion of the next registry entry into the sorted prefix
+    ace_common::PrintStr<32> name;
+    nameOf(mSorted, name);
+    uint16_t low = 0;
+    uint16_t high = mSorted;
+    while (low < high) {
+        uint16_t middle = (low + high) / 2;
+        ace_common::PrintStr<32> other;
+        nameOf(mIndexes[middle], other);
+        if (strcmp(other.getCstr(), name.getCstr()) <= 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    memmove(&mIndexes[low + 1], &mIndexes[low], (mSorted - low) * sizeof(uint16_t));
+    mIndexes[low] = mSorted;
+    mSorted++;
+
+    return mSorted == mSize;
+}
@@ -0,0 +1,41 @@
+/**
+ * CTW Nebenuhr - Zone list sorted by name, built in idle time
+ *
+ * handleRoot() used to sort all zones of the registry by name on every
+ * request, reading each name from flash many times. The cache sorts once,
+ * one binary insertion per idle slice, and is rebuilt when the timezone
+ * database changes.
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <AceTime.h>
+
+#include "IdleQueue.h"
+
+class ZoneIndexCache : public IdleJob {
+public:
+    ~ZoneIndexCache();
+
+    /** Drop the cache and start over for the given zone manager. */
+    void reset(ace_time::ExtendedZoneManager* manager);
+
+    /** True once the index covers the whole registry of this manager. */
+    bool isReadyFor(const ace_time::ExtendedZoneManager* manager) const;
+
+    const uint16_t* indexes() const { return mIndexes; }
+    uint16_t size() const { return mSize; }
+
+    bool step() override;
+    const char* name() const override { return "zone-index"; }
+
+private:
+    void nameOf(uint16_t index, Print& printer) const;
+
+    ace_time::ExtendedZoneManager* mManager = nullptr;
+    uint16_t* mIndexes = nullptr;
+    uint16_t mSize = 0;
+    uint16_t mSorted = 0;
+};
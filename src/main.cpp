@@ -34,12 +34,13 @@
 
 // Core ESP8266 and networking libraries
 #include <ArduinoOTA.h>
-#include <DNSServer.h>
 #include <ESP8266WebServer.h>
+#ifdef HTTPS_ADMIN
+#include <ESP8266WebServerSecure.h>
+#endif
 #include <ESP8266WiFi.h>
 #include <ESP8266mDNS.h>
 #include <ESP_DoubleResetDetector.h>
-#include <WiFiManager.h>
 #include <WiFiUdp.h>
 
 // Time zone handling library
@@ -51,19 +52,80 @@
 
 #include <list>
 
+#include "CallbackNtpClock.h"
+#include "Ds3231Rtc.h"
+#include "IdleQueue.h"
+#include "MasterLine.h"
+#include "PageTemplate.h"
+#include "Provisioning.h"
+#include "RootPage.h"
+#include "SlewingClock.h"
+#include "StepPlanner.h"
+#include "TzPartition.h"
+#include "WireBus.h"
+#include "ZoneIndexCache.h"
+#ifdef HTTPS_ADMIN
+#include "AdminCert.h"
+#endif
+
 #define TM1637_CLK D5
 #define TM1637_DIO D6
 
 #define OTA 1
 
+// Follow the minute impulses of an existing master clock, fed in via
+// optocoupler on this pin. NTP takes over when the line misbehaves.
+// #define MASTER_LINE_PIN D7
+// Followed dial may be this many minutes off the NTP time
+#define MASTER_MAX_DEVIATION_MINUTES 2
+
+// Administration (time, zone, tz database) only via HTTPS with basic auth,
+// needs key, certificate and credentials in src/AdminCert.h
+// (see AdminCert.h.example)
+// #define HTTPS_ADMIN 1
+
 #if !defined(NTP_SERVER)
 #define NTP_SERVER "pool.ntp.org"
 #endif
 
 #define DEBUG 1
+
+// Keep network transmissions back this long after a pulse, so the boost
+// converter can recover before the next current peak
+#define PULSE_TX_GUARD_MILLIS 50
+// Time lwIP needs to get queued data out. No new transmissions are started
+// this long before the minute pulse, and a pulse waits this long after the
+// last one.
+#define PULSE_TX_LEAD_MILLIS 150
+// Supply voltage drop during a pulse that is logged as droop event
+#define DROOP_THRESHOLD_MV 250
+
+// Upper bound for delaying the first NTP request once the network is up.
+// Clocks of a station all boot together after a power outage and join the
+// WiFi at about the same time, this spreads their requests.
+#define BOOT_SYNC_JITTER_MAX_MILLIS 3000
+
+// Battery-backed DS3231 RTC on I2C (SDA = D2, SCL = D1). Gives time and dial
+// position right after power-on, without network, and holds over NTP outages.
+// #define RTC_DS3231 1
+// Without NTP for this long, the RTC corrects the system clock
+#define RTC_HOLDOVER_MILLIS (2 * 3600 * 1000UL)
+
+// Evaluate a candidate stepping policy alongside the active one, logging
+// where they disagree. The candidate never drives the movement.
+// #define SHADOW_PLANNER 1
+
+// Time per loop() iteration given to deferred maintenance work
+#define IDLE_SLICE_MICROS 2000
 #define STATS_ADDRESS 10
 #define DRD_ADDRESS 4
 #define EEPROM_MAGIC_NUMBER 0xdeadbeef
+#define CONFIG_ADDRESS 64
+#define CONFIG_MAGIC_NUMBER 0xc0f19a7e
+#define CONFIG_VERSION 1
+
+// Measure the supply voltage via ADC, A0 is not used otherwise
+ADC_MODE(ADC_VCC);
 
 // Structure to persist operational statistics across reboots
 typedef struct {
@@ -77,6 +139,51 @@ typedef struct {
 
 statistics_t globalStats;
 
+// Versioned device configuration, kept apart from the statistics
+typedef struct {
+    uint32_t magicNumber; // Validation marker for EEPROM data integrity
+    uint16_t version; // Layout version, bumped on incompatible changes
+    char ssid[33]; // WiFi SSID, empty if not provisioned
+    char password[65]; // WiFi passphrase
+} config_t;
+
+config_t globalConfig;
+
+// Activity counters since boot, input for the energy model (tools/energy_model.py)
+struct {
+    uint32_t pulses = 0; // Coil pulses given
+    uint32_t pulseMillis = 0; // Time the coil was energised
+    uint64_t wifiConnectedMillis = 0; // Time associated with the AP, 64 bit as uptime
+    uint32_t httpRequests = 0; // Handled web requests
+    uint32_t displayUpdates = 0; // TM1637 writes
+    uint32_t flashCommits = 0; // EEPROM commits that erased the sector
+} activity;
+
+// Checksum of the EEPROM contents last written to flash
+uint32_t committedEEPromCrc = 0;
+
+uint32_t eepromCrc()
+{
+    return TzPartition::crc32(0, EEPROM.getConstDataPtr(), EEPROM.length());
+}
+
+/**
+ * Commit the EEPROM emulation to flash, counted for the energy model
+ * Only changed contents are written and counted, independent of how the
+ * core tracks changes (older ones mark the buffer dirty on any put()).
+ */
+void commitEEProm()
+{
+    uint32_t crc = eepromCrc();
+    if (crc == committedEEPromCrc) {
+        return;
+    }
+    if (EEPROM.commit()) {
+        committedEEPromCrc = crc;
+        activity.flashCommits++;
+    }
+}
+
 // Double reset detection - allows WiFi config reset via rapid power cycling
 DoubleResetDetector drd(DRD_ADDRESS, 0);
 
@@ -116,26 +223,89 @@ static const unsigned long REBOOT_TIMEOUT_MILLIS = 5000;
 using namespace ace_time;
 using namespace ace_time::zonedbx;
 using ace_time::clock::Clock;
-using ace_time::clock::NtpClock;
-using ace_time::clock::SystemClockLoop;
 
 static const int CACHE_SIZE = 3;
 ExtendedZoneProcessorCache<1> zoneProcessorCache;
 static ExtendedZoneProcessor localZoneProcessor;
 
-// Global timezone manager for handling all world timezones
-ExtendedZoneManager zoneManager(
+// Compiled-in timezone database, fallback if the tz partition is invalid
+ExtendedZoneManager builtinZoneManager(
     zonedbx::kZoneRegistrySize,
     zonedbx::kZoneRegistry,
     zoneProcessorCache);
 
+// Separately updatable timezone database in flash
+TzPartition tzPartition;
+bool tzUpdateOk = false;
+
+// Global timezone manager for handling all world timezones
+ExtendedZoneManager* zoneManager = &builtinZoneManager;
+
+// Deferred maintenance work, run only when nothing time critical is due
+IdleQueue idleQueue;
+ZoneIndexCache zoneIndexCache;
+
+/**
+ * Idle job committing the statistics to EEPROM
+ * Erasing the flash sector blocks for tens of milliseconds and cannot be
+ * split, an allowed exception to the slice budget: schedulerHasSlack()
+ * leaves at least two seconds to the next minute step.
+ */
+class PersistStatsJob : public IdleJob {
+public:
+    bool step() override
+    {
+        EEPROM.put(STATS_ADDRESS, globalStats);
+        commitEEProm();
+        return true;
+    }
+    const char* name() const override { return "persist-stats"; }
+};
+
+PersistStatsJob persistStatsJob;
+
 // Default to Central European timezone
-static TimeZone localZone = zoneManager.createForZoneInfo(&zonedbx::kZoneEurope_Berlin);
-static SystemClockLoop* globalSystemClock;
+static TimeZone localZone = builtinZoneManager.createForZoneInfo(&zonedbx::kZoneEurope_Berlin);
+static SlewingClock* globalSystemClock;
+static CallbackNtpClock* globalNtpClock;
 
 // Web server for configuration interface
 ESP8266WebServer server(80);
 
+void saveWifiCredentials(const char* ssid, const char* password);
+
+// WiFi setup via SoftAP and captive portal, only active while unconfigured
+Provisioning provisioning(server, "nebenuhr", saveWifiCredentials);
+
+#ifdef HTTPS_ADMIN
+// Cached TLS sessions let repeat admin requests skip the EC handshake
+#define ADMIN_SESSION_CACHE_SIZE 4
+// Browsers do not negotiate smaller TLS records, so the receive buffer must
+// hold a full record. Our own records are kept small.
+#define ADMIN_TLS_RX_BUFFER 16709
+#define ADMIN_TLS_TX_BUFFER 512
+// Handshakes faster than this are counted as resumed sessions
+#define ADMIN_RESUMED_HANDSHAKE_MILLIS 300
+// No new TLS clients this close before the minute pulse
+#define ADMIN_PULSE_GUARD_MILLIS 5000
+
+BearSSL::ESP8266WebServerSecure adminServer(443);
+BearSSL::ServerSessions adminSessions(ADMIN_SESSION_CACHE_SIZE);
+
+// TLS cost, to make sure security does not cost pulse accuracy
+struct {
+    uint32_t handshakes = 0;
+    uint32_t resumed = 0;
+    uint32_t lastFullMillis = 0;
+    uint32_t lastResumedMillis = 0;
+    uint32_t minFreeHeap = UINT32_MAX;
+} adminTls;
+
+// Set when the first handler of a request runs, ends the handshake timing
+bool adminHandlerStarted = false;
+unsigned long adminHandlerStartMillis = 0;
+#endif
+
 // Hardware pin assignments for clock control signals
 // OUT1 -> D3
 // OUT2 -> D4
@@ -145,130 +315,570 @@ ESP8266WebServer server(80);
 // Time tracking variables (in minutes from midnight)
 int16_t currentDisplayedTime = 9 * 60 + 44; // What the physical clock shows
 int16_t currentTime = 9 * 60 + 44; // Actual current time
+// Dial position known: set by the user, stored in the RTC or taken over
+// from the current time once that is known
+bool dialKnown = false;
+
+#ifdef MASTER_LINE_PIN
+MasterLine masterLine;
+// Time the master clock shows, counted from its impulses while following
+int16_t masterTime = 0;
+#endif
+
+#ifdef RTC_DS3231
+WireBus i2c;
+Ds3231Rtc rtc(i2c);
+// Time read from the RTC at boot, valid if nonzero
+int64_t rtcBootSeconds = 0;
+// Compare RTC and system clock, set the RTC on the next second boundary
+bool rtcCheckDue = true;
+bool rtcWriteDue = false;
+
+struct {
+    int32_t lastOutageSeconds = -1; // Power-off time before this boot, -1 = unknown
+    uint32_t writes = 0; // RTC set from NTP time
+    uint32_t holdoverCorrections = 0; // System clock set from the RTC
+} rtcStats;
+#endif
+
+// Stepping policy driving the movement: wait up to 10 minutes when ahead
+ThresholdPlanner activePlanner(10);
+#ifdef SHADOW_PLANNER
+FastestPlanner shadowPlanner;
+PlannerShadow plannerShadow(activePlanner, shadowPlanner);
+#endif
+
+// Timing of regular minute pulses relative to the minute boundary (negative = early)
+struct {
+    int32_t minMillis = INT32_MAX;
+    int32_t maxMillis = INT32_MIN;
+    uint32_t sumAbsMillis = 0;
+    uint32_t count = 0;
+} pulseTiming;
+
+// Coil pulse state, used to keep network transmissions off the pulse
+unsigned long pulseEndMillis = 0;
+// Last transmission started by us (HTTP response, NTP request)
+unsigned long txStartMillis = 0;
+// A step was held back for pending transmissions, retried from loop()
+bool pulseDeferred = false;
+
+// Supply voltage seen during pulses
+struct {
+    uint16_t minMillivolts = UINT16_MAX;
+    uint16_t droopEvents = 0;
+} supply;
 
 void setCurrentTime();
+void printTzdbVersion(Print& out);
+bool networkTxAllowed();
+uint32_t deviceJitterSeed();
+#ifdef RTC_DS3231
+void restoreFromRtc();
+#endif
+void seedDial();
 
 /**
- * Convert seconds to human-readable duration string
+ * Time the physical clock should show
+ * The master clock's time while following its line, NTP time otherwise
+ */
+int16_t targetTime()
+{
+#ifdef MASTER_LINE_PIN
+    if (masterLine.isFollowing()) {
+        return masterTime;
+    }
+#endif
+    return currentTime;
+}
+
+/**
+ * Whether targetTime() is real or just the initial placeholder
+ */
+bool targetKnown()
+{
+#ifdef MASTER_LINE_PIN
+    if (masterLine.isFollowing()) {
+        return true;
+    }
+#endif
+    return globalSystemClock && globalSystemClock->isInit();
+}
+
+/**
+ * Print seconds as human-readable duration
  * Formats as "Xd Yh Zm Ws" for display purposes
  */
-String secondsToString(uint32_t seconds)
+void printDuration(Print& out, uint32_t seconds)
 {
-    String result = "";
     if (seconds > 86400) {
-        result = String(seconds / 86400) + "d ";
+        out.printf_P(PSTR("%ud "), (unsigned)(seconds / 86400));
+    }
+    out.printf_P(PSTR("%uh %um %us"), (unsigned)((seconds / 3600) % 24),
+        (unsigned)((seconds / 60) % 60), (unsigned)(seconds % 60));
+}
+
+// Values shown on the main page, taken once so both render passes agree
+struct {
+    int hour;
+    int minute;
+    int64_t unixSeconds;
+    const uint16_t* zoneIndexes;
+    uint16_t zoneCount;
+} rootPage;
+
+/**
+ * Write the dynamic parts of the main page template (html/root.html)
+ */
+void writeRootSlot(Print& out, RootPageSlot slot)
+{
+    switch (slot) {
+    case RootPageSlot::None:
+        break;
+    case RootPageSlot::Hour:
+        out.print(rootPage.hour);
+        break;
+    case RootPageSlot::Minute:
+        out.print(rootPage.minute);
+        break;
+    case RootPageSlot::ZoneOptions:
+        for (uint16_t i = 0; i < rootPage.zoneCount; i++) {
+            ExtendedZone zone = zoneManager->getZoneForIndex(rootPage.zoneIndexes[i]);
+            out.printf_P(PSTR("<option value='%u'"), rootPage.zoneIndexes[i]);
+            if (zone.zoneId() == globalStats.zoneId) {
+                out.print(F(" selected='selected'"));
+            }
+            out.print('>');
+            zone.printNameTo(out);
+            out.print(F("</option>\n"));
+        }
+        break;
+    case RootPageSlot::CurrentTime:
+        ZonedDateTime::forUnixSeconds64(rootPage.unixSeconds, localZone).printTo(out);
+        break;
+    case RootPageSlot::Stats:
+        out.print(F("Uptime:"));
+        printDuration(out, globalStats.uptimeSeconds);
+        out.print(F("<br/>\nUptime gesamt:"));
+        printDuration(out, globalStats.uptimeSecondsTotal);
+        out.printf_P(PSTR("<br/>\nReboots:%u<br/>\n"), globalStats.reboots);
+        if (globalNtpClock) {
+            out.printf_P(PSTR("NTP Laufzeit:%d.%dms<br/>\n"),
+                (int)(globalNtpClock->getLastDelayMicros() / 1000),
+                (int)(globalNtpClock->getLastDelayMicros() / 100 % 10));
+            out.printf_P(PSTR("NTP Verarbeitungsverzug:%u.%ums<br/>\n"),
+                (unsigned)(globalNtpClock->getLastResponseAgeMicros() / 1000),
+                (unsigned)(globalNtpClock->getLastResponseAgeMicros() / 100 % 10));
+        }
+        if (globalSystemClock) {
+            out.printf_P(PSTR("Zeitkorrektur:%dms (offen %dms, %ux geregelt, %ux gesetzt)<br/>\n"),
+                (int)globalSystemClock->getLastOffsetMillis(),
+                (int)globalSystemClock->getPendingSlewMillis(),
+                globalSystemClock->getSlewCount(),
+                globalSystemClock->getStepCount());
+        }
+        out.printf_P(PSTR("Idle-Queue:%u Jobs, max %u, Auslastung %u%%<br/>\n"),
+            idleQueue.depth(), idleQueue.maxDepth(), idleQueue.utilisationPercent());
+        out.print(F("Zeitzonen:"));
+        printTzdbVersion(out);
+        out.print(zoneManager != &builtinZoneManager ? F(" (Partition)<br/>\n") : F(" (eingebaut)<br/>\n"));
+        if (supply.minMillivolts != UINT16_MAX) {
+            out.printf_P(PSTR("Versorgung min:%umV, Einbrüche: %u<br/>\n"),
+                supply.minMillivolts, supply.droopEvents);
+        }
+#ifdef RTC_DS3231
+        if (rtc.isPresent()) {
+            out.print(F("RTC: Stromausfall "));
+            if (rtcStats.lastOutageSeconds >= 0) {
+                printDuration(out, rtcStats.lastOutageSeconds);
+            } else {
+                out.print(F("unbekannt"));
+            }
+            out.printf_P(PSTR(", %ux gestellt, %ux Holdover-Korrektur<br/>\n"),
+                rtcStats.writes, rtcStats.holdoverCorrections);
+        }
+#endif
+#ifdef SHADOW_PLANNER
+        out.printf_P(PSTR("Schattenplaner %s:%u von %u Entscheidungen abweichend, %ux schneller, %ux langsamer<br/>\n"),
+            shadowPlanner.name(), plannerShadow.getDisagreementCount(), plannerShadow.getDecisionCount(),
+            plannerShadow.getShadowFasterCount(), plannerShadow.getShadowSlowerCount());
+#endif
+#ifdef MASTER_LINE_PIN
+        out.printf_P(PSTR("Hauptuhr:%s, Impulse %u, fehlend %u, zusätzlich %u, verworfen %u<br/>\n"),
+            masterLine.isFollowing() ? "folgt" : "NTP",
+            masterLine.getPulseCount(), masterLine.getMissingCount(),
+            masterLine.getExtraCount(), masterLine.getRejectCount());
+#endif
+        if (pulseTiming.count > 0) {
+            out.printf_P(PSTR("Impulsabweichung:%d..%dms, mittel %ums<br/>\n"),
+                (int)pulseTiming.minMillis, (int)pulseTiming.maxMillis,
+                (unsigned)(pulseTiming.sumAbsMillis / pulseTiming.count));
+        }
+        break;
+    case RootPageSlot::Version:
+        out.print(F(__TIMESTAMP__));
+        break;
+    case RootPageSlot::Logs:
+        // Recent log messages for debugging
+        if (logger.lastItems.size() > 0) {
+            out.print(F("<div class='logs'><h2>Logs</h2><ul>\n"));
+            for (std::list<String>::reverse_iterator line = logger.lastItems.rbegin();
+                line != logger.lastItems.rend();
+                line++) {
+                out.print(F("<li><pre>"));
+                out.print(*line);
+                out.print(F("</pre></li>\n"));
+            }
+            out.print(F("</ul></div>"));
+        }
+        break;
     }
-    result = result + String((seconds / 3600) % 24) + "h ";
-    result = result + String((seconds / 60) % 60) + "m ";
-    result = result + String(seconds % 60) + "s";
-    return result;
 }
 
 /**
  * Generate the main web interface
  * Provides time setting controls, timezone selection, and system status
  */
-void handleRoot()
+template <class Server>
+void handleRoot(Server& webServer)
 {
+    activity.httpRequests++;
+
     // Convert displayed time from minutes to hours:minutes format
-    int hour = (((1440 + currentDisplayedTime) / 60) % 24);
-    int minute = (1440 + currentDisplayedTime) % 60;
-
-    server.chunkedResponseModeStart(200, "text/html; charset=utf-8");
-
-    // HTML header and CSS styling for clean interface
-    String webpage = F("<!DOCTYPE html><html><head>\n");
-    webpage += F("<title>CTW Nebenuhr</title><style>\n");
-    webpage += F("body{margin-left:5em;margin-right:5em;font-family:sans-serif;font-size:14px;color:darkslategray;background-color:#EEE}h1{text-align:center}.info{width:100%;text-align:left;font-size:18pt}input,main,option,select,th{font-size:24pt;text-align:left}input{width:100%}input[type='submit']{width:min-content;float:right;text-align:right}main{font-size:16pt;vertical-align:middle}.info{line-height:2em}.info br{margin-left:3em}.logs{margin-top:2em;padding-top:2em;overflow-x:auto;border-top:black 2px solid}ul li{text-align:left}\n");
-    webpage += F(".graph {background-color: #EEE; font-size:0; overflow-x: auto; padding-bottom: 40px;} .bar { background-color: blueviolet; width: 1px; display: inline-block; } .active { background-color: green; }");
-    webpage += F("</style></head><body><h1>CTW Nebenuhr by Wolfgang Jung</h1><div class='main'>\n");
-
-    // Time adjustment form
-    webpage += F("<h2>Aktuell angezeigte Zeit:</h2>\n");
-    webpage += F("<form action=\"/set\" method=\"POST\"><table>\n");
-    webpage += F("<tr><th>Stunde:</th><td><input type=\"number\" name=\"hour\" value=\"") + String(hour) + F("\" min=\"0\" max=\"23\"></td></tr>");
-    webpage += F("<tr><th>Minute:</th><td><input type=\"number\" name=\"minute\" value=\"") + String(minute) + F("\" min=\"0\" max=\"59\"></td></tr>");
-    webpage += F("<tr><th>Zeitzone:</th><td><select name='zone'>\n");
-    server.sendContent(webpage);
-
-    // Generate sorted timezone dropdown list
-    uint16_t indexes[zonedbx::kZoneRegistrySize];
-    ace_time::ZoneSorterByName<ExtendedZoneManager> zoneSorter(zoneManager);
-    zoneSorter.fillIndexes(indexes, zonedbx::kZoneRegistrySize);
-    zoneSorter.sortIndexes(indexes, zonedbx::kZoneRegistrySize);
-    for (int i = 0; i < zonedbx::kZoneRegistrySize; i++) {
-        ace_common::PrintStr<32> printStr;
-        ExtendedZone zone = zoneManager.getZoneForIndex(indexes[i]);
-        zone.printNameTo(printStr);
-        webpage = "<option value='" + String(indexes[i]) + "'";
-        if (zone.zoneId() == globalStats.zoneId) {
-            webpage += F(" selected='selected'");
-        }
-        webpage += ">" + String(printStr.getCstr()) + "</option>\n";
-        server.sendContent(webpage);
+    rootPage.hour = (((1440 + currentDisplayedTime) / 60) % 24);
+    rootPage.minute = (1440 + currentDisplayedTime) % 60;
+    rootPage.unixSeconds = globalSystemClock ? globalSystemClock->getUnixMillis() / 1000 : 0;
+
+    // Sorted timezone dropdown list, sorting inline only until the
+    // idle-built cache is ready
+    uint16_t registrySize = zoneManager->zoneRegistrySize();
+    bool cached = zoneIndexCache.isReadyFor(zoneManager);
+    uint16_t sortedIndexes[cached ? 1 : registrySize];
+    rootPage.zoneIndexes = sortedIndexes;
+    rootPage.zoneCount = registrySize;
+    if (cached) {
+        rootPage.zoneIndexes = zoneIndexCache.indexes();
+    } else {
+        ace_time::ZoneSorterByName<ExtendedZoneManager> zoneSorter(*zoneManager);
+        zoneSorter.fillIndexes(sortedIndexes, registrySize);
+        zoneSorter.sortIndexes(sortedIndexes, registrySize);
     }
 
-    webpage = F("</select></td></tr>");
-    webpage += F("<tr><th></th><td><input id='save' type=\"submit\" value=\"Speichern\"></td></tr></table></form><br/></div>\n");
+    // Exact length first, so the page goes out without chunked encoding
+    webServer.setContentLength(measurePage(ROOT_PAGE, ROOT_PAGE_FRAGMENTS, writeRootSlot));
+    webServer.send(200, F("text/html; charset=utf-8"), "");
 
-    // Current time and system information display
-    webpage += F("<div class='info'>");
-    webpage += F("<div class='time'><h2>Aktuelle Zeit</h2><tt>");
+    ContentWriter<Server> writer(webServer);
+    renderPage(writer, ROOT_PAGE, ROOT_PAGE_FRAGMENTS, writeRootSlot);
+}
 
-    time_t localTime = time(nullptr);
-    ZonedDateTime zonedDateTime = ZonedDateTime::forUnixSeconds64(
-        localTime, localZone);
-    ace_common::PrintStr<60> currentTimeStr;
-    zonedDateTime.printTo(currentTimeStr);
+/**
+ * Print the version of the timezone database currently in use
+ */
+void printTzdbVersion(Print& out)
+{
+    if (zoneManager != &builtinZoneManager) {
+        out.print(tzPartition.header().tzVersion);
+    } else {
+        out.print(zonedbx::kTzDatabaseVersion);
+    }
+}
 
-    webpage += String(currentTimeStr.getCstr()) + "</tt></div></br>\n";
+/**
+ * Sort the zone list of the current timezone database in idle time
+ */
+void rebuildZoneIndex()
+{
+    zoneIndexCache.reset(zoneManager);
+    idleQueue.enqueue(&zoneIndexCache);
+}
 
-    // System statistics section
-    webpage += "<div class='stats'><h2>Stats</h2>\n";
-    webpage += "Uptime:" + secondsToString(globalStats.uptimeSeconds) + "<br/>\n";
-    webpage += "Uptime gesamt:" + secondsToString(globalStats.uptimeSecondsTotal) + "<br/>\n";
-    webpage += "Reboots:" + String(globalStats.reboots) + "<br/>\n";
-    webpage += "Version: " + String(__TIMESTAMP__) + "<br/></div></div>\n";
-    server.sendContent(webpage);
+/**
+ * Check whether there is slack for deferred maintenance work
+ * Nothing time critical may be due: no pulse, NTP exchange or HTTP request
+ */
+bool schedulerHasSlack()
+{
+    // Minute step due or deferred, or a pulse just finished. Catch-up steps
+    // are not timed and may wait for a slice, so a long catch-up after an
+    // outage or DST change does not starve the queue.
+    if (!networkTxAllowed()) {
+        return false;
+    }
+    // NTP exchange in flight or the next minute pulse is imminent
+    if (globalSystemClock
+        && (globalSystemClock->isRequestPending()
+            || globalSystemClock->getUnixMillis() % 60000 >= 58000)) {
+        return false;
+    }
+    // HTTP request waiting to be handled
+#ifdef HTTPS_ADMIN
+    if (adminServer.getServer().hasClient()) {
+        return false;
+    }
+#endif
+    return !server.getServer().hasClient();
+}
 
-    // Recent log messages for debugging
-    if (logger.lastItems.size() > 0) {
-        server.sendContent(F("<div class='logs'><h2>Logs</h2><ul>\n"));
+#ifdef HTTPS_ADMIN
+/**
+ * Configure the TLS admin server with EC key, session cache and buffer sizes
+ */
+void setupAdminServer()
+{
+    static BearSSL::X509List certificate(ADMIN_CERT);
+    static BearSSL::PrivateKey key(ADMIN_KEY);
+    adminServer.getServer().setECCert(&certificate, BR_KEYTYPE_KEYX | BR_KEYTYPE_SIGN, &key);
+    adminServer.getServer().setBufferSizes(ADMIN_TLS_RX_BUFFER, ADMIN_TLS_TX_BUFFER);
+    adminServer.getServer().setCache(&adminSessions);
+    adminServer.begin();
+}
 
-        for (std::list<String>::reverse_iterator line = logger.lastItems.rbegin();
-            line != logger.lastItems.rend();
-            line++) {
-            server.sendContent("<li><pre>" + (*line) + "</pre></li>\n");
-        }
-        server.sendContent(F("</ul></div>"));
+/**
+ * Note the end of the connection setup, every admin handler starts here
+ */
+void markAdminHandlerStart()
+{
+    if (!adminHandlerStarted) {
+        adminHandlerStarted = true;
+        adminHandlerStartMillis = millis();
+    }
+}
+
+/**
+ * Check basic auth on the admin server, asks the browser for it if missing
+ */
+bool adminAuthenticated()
+{
+    markAdminHandlerStart();
+    if (adminServer.authenticate(ADMIN_USER, ADMIN_PASSWORD)) {
+        return true;
+    }
+    adminServer.requestAuthentication();
+    return false;
+}
+
+/**
+ * Serve the admin server, recording the cost of new TLS connections
+ * The handshake runs when a new client is accepted, in the first
+ * handleClient() call of a connection. It is timed up to the start of the
+ * request handler, so the timing includes reading the request but not
+ * handling it. Requests without handler (404) are timed as a whole.
+ */
+void handleAdminClient()
+{
+    bool newClient = adminServer.getServer().hasClient();
+    adminHandlerStarted = false;
+    unsigned long start = millis();
+    adminServer.handleClient();
+    if (!newClient) {
+        return;
     }
 
-    server.sendContent(F("</body></html>\n"));
-    server.chunkedResponseFinalize();
+    uint32_t duration = (adminHandlerStarted ? adminHandlerStartMillis : millis()) - start;
+    adminTls.handshakes++;
+    if (duration < ADMIN_RESUMED_HANDSHAKE_MILLIS) {
+        adminTls.resumed++;
+        adminTls.lastResumedMillis = duration;
+    } else {
+        adminTls.lastFullMillis = duration;
+    }
+    adminTls.minFreeHeap = min(adminTls.minFreeHeap, ESP.getFreeHeap());
+}
+
+/**
+ * A full TLS handshake blocks the loop for up to seconds, only accept new
+ * admin clients while no minute pulse is due
+ */
+bool adminHandshakeAllowed()
+{
+    if (!networkTxAllowed()) {
+        return false;
+    }
+    return !globalSystemClock
+        || globalSystemClock->getUnixMillis() % 60000 < 60000 - ADMIN_PULSE_GUARD_MILLIS;
+}
+#endif
+
+/**
+ * Fall back to the compiled-in timezone database
+ * Required before the tz partition is overwritten, as zones are read in place
+ */
+void useBuiltinZones()
+{
+    zoneManager = &builtinZoneManager;
+    localZone = zoneManager->createForZoneId(globalStats.zoneId);
+    if (localZone.isError()) {
+        localZone = zoneManager->createForZoneInfo(&zonedbx::kZoneEurope_Berlin);
+    }
+    rebuildZoneIndex();
+}
+
+/**
+ * Machine readable status, for monitoring and update tooling
+ */
+void handleStatus()
+{
+    activity.httpRequests++;
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08x", tzPartition.isValid() ? tzPartition.header().crc32 : 0);
+
+    String json = F("{");
+    json += "\"uptime\":" + String(globalStats.uptimeSeconds);
+    json += ",\"uptimeTotal\":" + String(globalStats.uptimeSecondsTotal);
+    json += ",\"reboots\":" + String(globalStats.reboots);
+    json += ",\"displayed\":" + String(currentDisplayedTime);
+    json += ",\"current\":" + String(currentTime);
+    json += F(",\"tzdb\":{\"source\":\"");
+    json += zoneManager != &builtinZoneManager ? F("partition") : F("builtin");
+    ace_common::PrintStr<16> version;
+    printTzdbVersion(version);
+    json += "\",\"version\":\"" + String(version.getCstr());
+    json += "\",\"crc32\":\"" + String(crc);
+    json += "\",\"capacity\":" + String(tzPartition.capacity());
+    json += F("},\"idle\":{\"depth\":");
+    json += String(idleQueue.depth());
+    json += ",\"maxDepth\":" + String(idleQueue.maxDepth());
+    json += ",\"completed\":" + String(idleQueue.completedJobs());
+    json += ",\"dropped\":" + String(idleQueue.droppedJobs());
+    json += ",\"utilisation\":" + String(idleQueue.utilisationPercent());
+    json += F("},\"activity\":{\"cpuMHz\":");
+    json += String(ESP.getCpuFreqMHz());
+    // 64 bit, millis() wraps after 49.7 days
+    json += ",\"uptimeMillis\":" + String((unsigned long long)(micros64() / 1000));
+    json += ",\"pulses\":" + String(activity.pulses);
+    json += ",\"pulseMillis\":" + String(activity.pulseMillis);
+    json += ",\"wifiConnectedMillis\":" + String((unsigned long long)activity.wifiConnectedMillis);
+    json += ",\"ntpRequests\":" + String(globalSystemClock ? globalSystemClock->getRequestCount() : 0);
+    json += ",\"httpRequests\":" + String(activity.httpRequests);
+    json += ",\"displayUpdates\":" + String(activity.displayUpdates);
+    // Sector erases, of the EEPROM and of timezone database updates
+    json += ",\"flashCommits\":" + String(activity.flashCommits + tzPartition.sectorErases());
+#ifdef RTC_DS3231
+    json += F("},\"rtc\":{\"present\":");
+    json += rtc.isPresent() ? F("true") : F("false");
+    json += ",\"lastOutageSeconds\":" + String(rtcStats.lastOutageSeconds);
+    json += ",\"writes\":" + String(rtcStats.writes);
+    json += ",\"holdoverCorrections\":" + String(rtcStats.holdoverCorrections);
+#endif
+#ifdef SHADOW_PLANNER
+    json += F("},\"planner\":{\"active\":\"");
+    json += activePlanner.name();
+    json += F("\",\"shadow\":\"");
+    json += shadowPlanner.name();
+    json += "\",\"decisions\":" + String(plannerShadow.getDecisionCount());
+    json += ",\"disagreements\":" + String(plannerShadow.getDisagreementCount());
+    json += ",\"episodes\":" + String(plannerShadow.getEpisodeCount());
+    json += ",\"shadowFaster\":" + String(plannerShadow.getShadowFasterCount());
+    json += ",\"shadowSlower\":" + String(plannerShadow.getShadowSlowerCount());
+    json += ",\"lastActiveSeconds\":" + String(plannerShadow.getLastActiveSeconds());
+    json += ",\"lastShadowSeconds\":" + String(plannerShadow.getLastShadowSeconds());
+#endif
+#ifdef MASTER_LINE_PIN
+    json += F("},\"master\":{\"following\":");
+    json += masterLine.isFollowing() ? F("true") : F("false");
+    json += ",\"time\":" + String(masterTime);
+    json += ",\"pulses\":" + String(masterLine.getPulseCount());
+    json += ",\"missing\":" + String(masterLine.getMissingCount());
+    json += ",\"extra\":" + String(masterLine.getExtraCount());
+    json += ",\"rejected\":" + String(masterLine.getRejectCount());
+#endif
+#ifdef HTTPS_ADMIN
+    json += F("},\"https\":{\"handshakes\":");
+    json += String(adminTls.handshakes);
+    json += ",\"resumed\":" + String(adminTls.resumed);
+    json += ",\"lastFullMillis\":" + String(adminTls.lastFullMillis);
+    json += ",\"lastResumedMillis\":" + String(adminTls.lastResumedMillis);
+    json += ",\"minFreeHeap\":" + String(adminTls.minFreeHeap);
+    json += ",\"sessionCache\":" + String(ADMIN_SESSION_CACHE_SIZE);
+#endif
+    json += F("}}\n");
+    server.send(200, F("application/json"), json);
+}
+
+/**
+ * Receive a new timezone database image for the tz partition
+ */
+template <class Server>
+void handleTzdbUpload(Server& webServer)
+{
+    HTTPUpload& upload = webServer.upload();
+    if (upload.status == UPLOAD_FILE_START) {
+        logger.println(F("Timezone database update started"));
+        useBuiltinZones();
+        tzUpdateOk = tzPartition.beginUpdate();
+    } else if (upload.status == UPLOAD_FILE_WRITE) {
+        tzUpdateOk = tzUpdateOk && tzPartition.writeUpdate(upload.buf, upload.currentSize);
+    } else if (upload.status == UPLOAD_FILE_END) {
+        tzUpdateOk = tzUpdateOk && tzPartition.endUpdate();
+    } else {
+        tzPartition.abortUpdate();
+        tzUpdateOk = false;
+    }
+}
+
+/**
+ * Report the result of a timezone database update and restart to use it
+ */
+template <class Server>
+void handleTzdbDone(Server& webServer)
+{
+    if (!tzUpdateOk) {
+        logger.println(F("Timezone database update failed"));
+        webServer.send(400, F("text/plain"), F("Invalid timezone database image"));
+        return;
+    }
+    logger.println(F("Timezone database updated, restarting"));
+    webServer.send(200, F("text/plain"), String(F("Timezone database ")) + tzPartition.header().tzVersion);
+    EEPROM.put(STATS_ADDRESS, globalStats);
+    commitEEProm();
+    delay(REBOOT_TIMEOUT_MILLIS);
+    ESP.restart();
 }
 
 /**
  * Process time and timezone setting form submission
  * Updates displayed time and saves new timezone preference
  */
-void handleSet()
+template <class Server>
+void handleSet(Server& webServer)
 {
-    int hour = server.arg("hour").toInt();
-    int minute = server.arg("minute").toInt();
-    int zoneIdx = server.arg("zone").toInt();
+    activity.httpRequests++;
+    int hour = webServer.arg("hour").toInt();
+    int minute = webServer.arg("minute").toInt();
+    int zoneIdx = webServer.arg("zone").toInt();
     currentDisplayedTime = (hour * 60 + minute) % 1440;
+    dialKnown = true;
+#ifdef RTC_DS3231
+    rtc.writeDial(currentDisplayedTime);
+#endif
 
     // Update timezone if valid selection made
-    localZone = zoneManager.createForZoneIndex(zoneIdx);
+    localZone = zoneManager->createForZoneIndex(zoneIdx);
     if (localZone.isError() == false) {
+        // The user's choice is committed right away, a reset must not lose it
         globalStats.zoneId = localZone.getZoneId();
         EEPROM.put(STATS_ADDRESS, globalStats);
-        EEPROM.commit();
+        commitEEProm();
     }
 
     // Redirect back to main page
-    server.sendHeader(F("Location"), "/");
-    server.send(302, F("text/plain"), "");
+    webServer.sendHeader(F("Location"), "/");
+    webServer.send(302, F("text/plain"), "");
+}
+
+/**
+ * Persist new WiFi credentials entered in the provisioning portal
+ */
+void saveWifiCredentials(const char* ssid, const char* password)
+{
+    strncpy(globalConfig.ssid, ssid, sizeof(globalConfig.ssid) - 1);
+    strncpy(globalConfig.password, password, sizeof(globalConfig.password) - 1);
+    globalConfig.ssid[sizeof(globalConfig.ssid) - 1] = '\0';
+    globalConfig.password[sizeof(globalConfig.password) - 1] = '\0';
+    EEPROM.put(CONFIG_ADDRESS, globalConfig);
+    commitEEProm();
+    logger.println(F("WiFi credentials saved"));
 }
 
 /**
@@ -279,6 +889,7 @@ void readFromEEProm()
 {
     // EEPROM.begin(sizeof(statistics_t));
     // Already got begin() called by DRD constructor
+    committedEEPromCrc = eepromCrc();
     EEPROM.get(STATS_ADDRESS, globalStats);
 
     // Check for valid stored data, initialize defaults if corrupted
@@ -296,19 +907,34 @@ void readFromEEProm()
     globalStats.previousSecondsTotal = globalStats.uptimeSecondsTotal;
 
     // Restore timezone from saved preference
-    localZone = zoneManager.createForZoneId(globalStats.zoneId);
+    localZone = zoneManager->createForZoneId(globalStats.zoneId);
     if (localZone.isError()) {
         // Fallback to default if saved timezone invalid
         globalStats.zoneId = zonedbx::kZoneIdEurope_Berlin;
-        localZone = zoneManager.createForZoneId(globalStats.zoneId);
+        localZone = zoneManager->createForZoneId(globalStats.zoneId);
         EEPROM.put(STATS_ADDRESS, globalStats);
     }
     globalStats.uptimeSeconds = 0;
 
+    // Unknown or outdated configuration layout starts unprovisioned
+    EEPROM.get(CONFIG_ADDRESS, globalConfig);
+    if (globalConfig.magicNumber != CONFIG_MAGIC_NUMBER || globalConfig.version != CONFIG_VERSION) {
+        memset(&globalConfig, 0, sizeof(globalConfig));
+        globalConfig.magicNumber = CONFIG_MAGIC_NUMBER;
+        globalConfig.version = CONFIG_VERSION;
+        // Clocks upgraded from WiFiManager only have the SDK's stored copy
+        strncpy(globalConfig.ssid, WiFi.SSID().c_str(), sizeof(globalConfig.ssid) - 1);
+        strncpy(globalConfig.password, WiFi.psk().c_str(), sizeof(globalConfig.password) - 1);
+        if (globalConfig.ssid[0] != '\0') {
+            logger.printf("WiFi credentials for %s taken over\n", globalConfig.ssid);
+        }
+        EEPROM.put(CONFIG_ADDRESS, globalConfig);
+    }
+
     Serial.print(F("Using Timezone: "));
     localZone.printTo(Serial);
     Serial.println();
-    EEPROM.commit();
+    commitEEProm();
 }
 
 /**
@@ -321,9 +947,28 @@ void setup()
     display.showNumberDec(0);
 
     Serial.begin(115200);
+
+    // Prefer the separately updated timezone database, if there is a valid one
+    if (tzPartition.begin()) {
+        static ExtendedZoneManager partitionZoneManager(
+            tzPartition.registrySize(),
+            tzPartition.registry(),
+            zoneProcessorCache);
+        zoneManager = &partitionZoneManager;
+    }
     readFromEEProm();
+    rebuildZoneIndex();
+#ifdef RTC_DS3231
+    // Read before any network is up, the time is valid unless the battery ran out
+    i2c.begin();
+    if (rtc.begin() && !rtc.readUnixSeconds(rtcBootSeconds)) {
+        rtcBootSeconds = 0;
+    }
+#endif
     globalStats.uptimeSeconds = 0;
     Serial.println(F("\nStarting CTW Nebenuhr 2025 - Wolfgang Jung / Ideas In Logic\n"));
+    // Brown-outs during pulses show up as watchdog or power-on resets
+    logger.println("Reset reason: " + ESP.getResetReason());
 
     // Configure hardware control pins for clock mechanism
     pinMode(OUT1, OUTPUT);
@@ -335,33 +980,25 @@ void setup()
     digitalWrite(OUT1, LOW);
     digitalWrite(OUT2, LOW);
 
-    WiFiManager wiFiManager;
+    provisioning.setup();
 
     // Check for double reset to enter WiFi configuration mode
     display.showNumberDec(1);
     if (drd.detectDoubleReset()) {
-        display.showNumberDec(1);
         digitalWrite(LED_BUILTIN, HIGH);
         Serial.println(F("Reset WiFi configuration"));
-        wiFiManager.resetSettings();
+        saveWifiCredentials("", "");
+        // Otherwise the SDK reconnects to the old network with its own copy
+        provisioning.eraseSdkCredentials();
         display.showNumberDec(2);
-        wiFiManager.startConfigPortal("nebenuhr", "");
     }
 
-    // Attempt to connect to previously configured WiFi
+    // Start connecting to the configured WiFi, opens the portal if there is none
 #ifdef DEBUG
     logger.println(F("Trying to connect to known WiFi"));
 #endif
     display.showNumberDec(3);
-    if (!wiFiManager.autoConnect("nebenuhr")) {
-        display.showNumberDec(4);
-        digitalWrite(LED_BUILTIN, HIGH);
-        Serial.println(F("failed to connect and hit timeout"));
-        delay(3000);
-        digitalWrite(LED_BUILTIN, LOW);
-        // Connection failed - restart and try again
-        ESP.reset();
-    }
+    provisioning.begin(globalConfig.ssid, globalConfig.password);
     display.showNumberDec(5);
 
     // Enable local network discovery
@@ -376,10 +1013,44 @@ void setup()
 
     // Configure web server endpoints
     digitalWrite(LED_BUILTIN, HIGH);
-    server.on("/", HTTP_GET, handleRoot);
-    server.on("/set", HTTP_POST, handleSet);
+    server.on("/status", HTTP_GET, handleStatus);
+#ifdef HTTPS_ADMIN
+    // Administration only via TLS with authentication, plain HTTP redirects
+    server.on("/", HTTP_GET, []() {
+        server.sendHeader(F("Location"), String(F("https://")) + WiFi.localIP().toString() + "/");
+        server.send(301, F("text/plain"), "");
+    });
+    adminServer.on("/", HTTP_GET, []() {
+        if (adminAuthenticated()) {
+            handleRoot(adminServer);
+        }
+    });
+    adminServer.on("/set", HTTP_POST, []() {
+        if (adminAuthenticated()) {
+            handleSet(adminServer);
+        }
+    });
+    adminServer.on("/tzdb", HTTP_POST, []() {
+        if (adminAuthenticated()) {
+            handleTzdbDone(adminServer);
+        }
+    }, []() {
+        // Checked per chunk, nothing is written before authentication
+        markAdminHandlerStart();
+        if (adminServer.authenticate(ADMIN_USER, ADMIN_PASSWORD)) {
+            handleTzdbUpload(adminServer);
+        }
+    });
+    setupAdminServer();
+#else
+    server.on("/", HTTP_GET, []() { handleRoot(server); });
+    server.on("/set", HTTP_POST, []() { handleSet(server); });
+    server.on("/tzdb", HTTP_POST, []() { handleTzdbDone(server); }, []() { handleTzdbUpload(server); });
+#endif
     server.onNotFound([]() {
-        server.send(404, F("text/plain"), F("404: Not found"));
+        if (!provisioning.handleCaptivePortal()) {
+            server.send(404, F("text/plain"), F("404: Not found"));
+        }
     });
     server.begin();
 
@@ -389,15 +1060,25 @@ void setup()
 
     display.showNumberDec(7);
 
-    // Get accurate time from internet
-    static NtpClock ntpClock("de.pool.ntp.org");
+    // Get accurate time from internet, replies are timestamped on arrival
+    static CallbackNtpClock ntpClock("de.pool.ntp.org");
     ntpClock.setup();
+    globalNtpClock = &ntpClock;
     display.showNumberDec(8);
-    static SystemClockLoop systemClock(&ntpClock, (Clock*)0);
+    static SlewingClock systemClock(&ntpClock);
+    systemClock.setRequestGate(networkTxAllowed);
+    systemClock.setJitter(deviceJitterSeed(), BOOT_SYNC_JITTER_MAX_MILLIS);
     systemClock.setup();
+#ifdef RTC_DS3231
+    if (rtcBootSeconds != 0) {
+        // Second phase unknown, half a second off at most. NTP slews later.
+        systemClock.setUnixMillis(rtcBootSeconds * 1000 + 500);
+    }
+#endif
 
     display.showNumberDec(9);
-    for (int x = 0; x < 100 && systemClock.getNow() == systemClock.kInvalidSeconds; x++) {
+    for (int x = 0; x < 250 && !systemClock.isInit() && !provisioning.isPortalActive(); x++) {
+        provisioning.loop();
         systemClock.loop();
         delay(100);
 #ifdef DEBUG
@@ -406,16 +1087,28 @@ void setup()
     }
     display.showNumberDec(10);
     globalSystemClock = &systemClock;
-    setCurrentTime();
+#ifdef RTC_DS3231
+    restoreFromRtc();
+#endif
+    // Without NTP yet (portal open, AP still booting) loop() does this later
+    seedDial();
 
-    // Assume clock lost minimal time during power outage
-    currentDisplayedTime = currentTime;
+#ifdef MASTER_LINE_PIN
+    masterLine.begin(MASTER_LINE_PIN);
+#endif
 
 #ifdef OTA
     // Enable over-the-air firmware updates
     ArduinoOTA.setPort(8266);
 
     ArduinoOTA.setHostname("nebenuhr");
+#ifdef HTTPS_ADMIN
+    // Unauthenticated OTA would bypass the protected admin endpoints
+#ifndef ADMIN_OTA_PASSWORD_MD5
+#error "HTTPS_ADMIN needs ADMIN_OTA_PASSWORD_MD5 in AdminCert.h, or disable OTA"
+#endif
+    ArduinoOTA.setPasswordHash(ADMIN_OTA_PASSWORD_MD5);
+#endif
 
     // OTA event handlers for status reporting
     ArduinoOTA.onStart([]() {
@@ -423,7 +1116,9 @@ void setup()
         if (ArduinoOTA.getCommand() == U_FLASH) {
             type = "sketch";
         } else { // U_FS
+            // The filesystem region holds the timezone database
             type = "filesystem";
+            useBuiltinZones();
         }
         Serial.println("Start updating " + type);
     });
@@ -464,11 +1159,16 @@ void setCurrentTime()
         logger.print("No time set");
         return;
     }
+    if (!globalSystemClock->isInit()) {
+        // Not synced yet, keep the last known time
+        return;
+    }
     acetime_t now = globalSystemClock->getNow();
 
     ZonedDateTime zonedDateTime = ZonedDateTime::forEpochSeconds(now, localZone);
     currentTime = zonedDateTime.minute() + zonedDateTime.hour() * 60;
     display.showNumberDecEx(zonedDateTime.hour() * 100 + zonedDateTime.minute(), 0xC0, true);
+    activity.displayUpdates++;
 
     // Pre-advance if close to next minute to prevent timing issues
     if (zonedDateTime.second() == 59) {
@@ -476,6 +1176,173 @@ void setCurrentTime()
     }
 }
 
+#ifdef RTC_DS3231
+/**
+ * Continue from the dial position stored in the RTC and log the outage
+ */
+void restoreFromRtc()
+{
+    int16_t dial;
+    if (!rtc.readDial(dial)) {
+        return;
+    }
+    currentDisplayedTime = dial;
+    dialKnown = true;
+
+    int64_t heartbeatSeconds;
+    if (rtcBootSeconds != 0 && rtc.readHeartbeat(heartbeatSeconds)
+        && heartbeatSeconds <= rtcBootSeconds && rtcBootSeconds - heartbeatSeconds < INT32_MAX) {
+        rtcStats.lastOutageSeconds = rtcBootSeconds - heartbeatSeconds;
+    }
+    logger.printf("Dial at %02d:%02d, power was off for %d s\n",
+        dial / 60, dial % 60, (int)rtcStats.lastOutageSeconds);
+}
+
+/**
+ * Keep the RTC disciplined from NTP, and use it as holdover reference while
+ * NTP is unreachable. Checked after every NTP sync and every 15 minutes.
+ */
+void serviceRtc()
+{
+    static uint32_t seenReferenceSyncs = 0;
+    if (globalSystemClock->getReferenceSyncCount() != seenReferenceSyncs) {
+        seenReferenceSyncs = globalSystemClock->getReferenceSyncCount();
+        rtcCheckDue = true;
+    }
+    if (!rtcCheckDue || !rtc.isPresent() || !globalSystemClock->isInit()) {
+        return;
+    }
+
+    int64_t systemMillis = globalSystemClock->getUnixMillis();
+    uint16_t fraction = systemMillis % 1000;
+    bool disciplined = seenReferenceSyncs > 0
+        && globalSystemClock->getMillisSinceReferenceSync() < RTC_HOLDOVER_MILLIS;
+
+    if (rtcWriteDue) {
+        // Writing the seconds restarts the RTC's second, so write right after ours
+        if (!disciplined) {
+            rtcWriteDue = false;
+        } else if (fraction < 20) {
+            if (rtc.writeUnixSeconds(systemMillis / 1000)) {
+                rtcStats.writes++;
+            }
+            rtcWriteDue = false;
+            rtcCheckDue = false;
+        }
+        return;
+    }
+
+    // Compare mid-second, the RTC only has whole seconds
+    if (fraction < 400 || fraction >= 600) {
+        return;
+    }
+    int64_t rtcSeconds;
+    bool valid = rtc.readUnixSeconds(rtcSeconds);
+    int64_t difference = valid ? rtcSeconds - systemMillis / 1000 : 0;
+    if (disciplined) {
+        rtcWriteDue = !valid || difference != 0;
+        rtcCheckDue = rtcWriteDue;
+    } else {
+        // Holdover: the RTC drifts far less than the ESP8266 crystal
+        if (valid && (difference >= 2 || difference <= -2)) {
+            globalSystemClock->setUnixMillis(rtcSeconds * 1000 + 500);
+            rtcStats.holdoverCorrections++;
+            logger.printf("No NTP, system clock set from RTC (%d s)\n", (int)difference);
+        }
+        rtcCheckDue = false;
+    }
+}
+#endif
+
+/**
+ * Per-device seed for spreading periodic network tasks
+ * FNV-1a hash of the MAC address, stable across reboots
+ */
+uint32_t deviceJitterSeed()
+{
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < sizeof(mac); i++) {
+        hash = (hash ^ mac[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+/**
+ * Check whether non-urgent network transmissions (NTP, mDNS, HTTP) may go out
+ * A WiFi TX burst on top of a coil pulse causes supply droop and brown-outs.
+ * advance() blocks loop(), so nothing is started during a pulse; this keeps
+ * transmissions off the time right before and after one.
+ */
+bool networkTxAllowed()
+{
+    if (pulseDeferred || millis() - pulseEndMillis < PULSE_TX_GUARD_MILLIS) {
+        return false;
+    }
+    if (!dialKnown || !targetKnown()) {
+        return true;
+    }
+    // Catch-up steps wait for the transmissions instead, see syncDial()
+    switch ((targetTime() - currentDisplayedTime + 2880) % 1440) {
+    case 0:
+        // In sync, the next step is due at the minute boundary
+        return globalSystemClock->getUnixMillis() % 60000 < 60000 - PULSE_TX_LEAD_MILLIS;
+    case 1:
+        // Minute step due right now
+        return false;
+    default:
+        return true;
+    }
+}
+
+/**
+ * Note a transmission we started, a following pulse waits for it to go out
+ */
+void noteNetworkTx()
+{
+    txStartMillis = millis();
+}
+
+/**
+ * Whether handleClient() will answer a request, i.e. transmit
+ */
+template <class Server>
+bool requestWaiting(Server& webServer)
+{
+    return webServer.getServer().hasClient() || webServer.client().available() > 0;
+}
+
+/**
+ * Record the lowest supply voltage of a pulse, at most one droop event each
+ */
+void recordSupply(uint16_t baselineMillivolts, uint16_t pulseMillivolts)
+{
+    if (pulseMillivolts < supply.minMillivolts) {
+        supply.minMillivolts = pulseMillivolts;
+    }
+    if (baselineMillivolts > pulseMillivolts + DROOP_THRESHOLD_MV) {
+        supply.droopEvents++;
+        logger.printf("Supply droop during pulse: %u mV -> %u mV\n", baselineMillivolts, pulseMillivolts);
+    }
+}
+
+/**
+ * Record how far a regular minute pulse is off the minute boundary
+ * Catch-up pulses are not counted, only steps that keep the clock in sync
+ */
+void recordPulseTiming()
+{
+    if (!globalSystemClock || !globalSystemClock->isInit()) {
+        return;
+    }
+    int32_t error = (int32_t)((globalSystemClock->getUnixMillis() + 30000) % 60000) - 30000;
+    pulseTiming.minMillis = min(pulseTiming.minMillis, error);
+    pulseTiming.maxMillis = max(pulseTiming.maxMillis, error);
+    pulseTiming.sumAbsMillis += abs(error);
+    pulseTiming.count++;
+}
+
 /**
  * Advance the physical clock by one minute
  * Uses alternating pulses to drive the clock mechanism forward
@@ -483,6 +1350,8 @@ void setCurrentTime()
 void advance()
 {
     uint8_t STEPS[] = { 0, 4, 8, 16, 32, 64, 128, 192, 255 };
+    uint16_t baselineMillivolts = ESP.getVcc();
+    unsigned long pulseStartMillis = millis();
     for (size_t x = 0; x < sizeof(STEPS) / sizeof(STEPS[0]); x++) {
         // Generate alternating pulse pattern for clock drive mechanism
         if (currentDisplayedTime % 2 == 0) {
@@ -494,17 +1363,151 @@ void advance()
         }
         delay(30);
     }
-    delay(200); // Pulse duration for reliable clock movement
+    // Pulse duration for reliable clock movement, supply sampled at full current
+    uint16_t pulseMillivolts = UINT16_MAX;
+    for (int x = 0; x < 4; x++) {
+        delay(50);
+        pulseMillivolts = min(pulseMillivolts, (uint16_t)ESP.getVcc());
+    }
     digitalWrite(OUT1, LOW);
     digitalWrite(OUT2, LOW);
+    pulseEndMillis = millis();
+    recordSupply(baselineMillivolts, pulseMillivolts);
+    activity.pulses++;
+    activity.pulseMillis += pulseEndMillis - pulseStartMillis;
 
     // Update our tracking of displayed time
     currentDisplayedTime++;
     if (currentDisplayedTime >= 1440) { // Handle midnight rollover
         currentDisplayedTime -= 1440;
     }
+#ifdef RTC_DS3231
+    rtc.writeDial(currentDisplayedTime);
+#endif
 }
 
+/**
+ * Take the current time as dial position, once the time is known
+ * Assumes the clock lost minimal time during the power outage. Until then
+ * the movement is held, stepping from a made-up position would run it off.
+ */
+void seedDial()
+{
+    if (dialKnown || !globalSystemClock->isInit()) {
+        return;
+    }
+    setCurrentTime();
+    currentDisplayedTime = currentTime;
+    dialKnown = true;
+}
+
+/**
+ * Bring the physical clock one step closer to the target time
+ */
+void syncDial()
+{
+    pulseDeferred = false;
+    // Without time or dial position every step would be a guess
+    if (!dialKnown || !targetKnown()) {
+        return;
+    }
+    int16_t target = targetTime();
+#ifdef SHADOW_PLANNER
+    uint8_t second = globalSystemClock->getUnixMillis() / 1000 % 60;
+    StepAction action = plannerShadow.decide(currentDisplayedTime, target, second);
+    if (plannerShadow.disagreementStarted()) {
+        logger.printf("Planner %s: %s (%us), %s: %s (%us) at %d -> %d\n",
+            activePlanner.name(), stepActionName(plannerShadow.getLastActiveAction()),
+            plannerShadow.getLastActiveSeconds(),
+            shadowPlanner.name(), stepActionName(plannerShadow.getLastShadowAction()),
+            plannerShadow.getLastShadowSeconds(),
+            currentDisplayedTime, target);
+    }
+#else
+    StepAction action = activePlanner.plan(currentDisplayedTime, target);
+#endif
+
+    switch (action) {
+    case StepAction::Hold:
+        // Synchronized, or waiting for the time to catch up with the clock
+        break;
+    case StepAction::Advance:
+        // Clock is behind - advance one minute
+        // Data queued by lwIP would go out on top of the pulse current
+        if (millis() - txStartMillis < PULSE_TX_LEAD_MILLIS) {
+            pulseDeferred = true;
+            break;
+        }
+        if (currentDisplayedTime + 1 == target) {
+            recordPulseTiming();
+        }
+        advance();
+        break;
+    case StepAction::Wrap:
+        // Clock is significantly ahead - reset to previous day for catch-up
+        currentDisplayedTime -= 1440;
+        break;
+    }
+}
+
+#ifdef MASTER_LINE_PIN
+/**
+ * Local time of day in minutes at the minute boundary closest to unixMillis
+ */
+int16_t nearestLocalMinute(int64_t unixMillis)
+{
+    int64_t unixSeconds = (unixMillis + 30000) / 60000 * 60;
+    ZonedDateTime zonedDateTime = ZonedDateTime::forUnixSeconds64(unixSeconds, localZone);
+    return zonedDateTime.hour() * 60 + zonedDateTime.minute();
+}
+
+/**
+ * Follow the master clock line, cross-checked against NTP
+ * Impulses are stepped right away, NTP takes over if the line misbehaves
+ */
+void followMasterLine()
+{
+    MasterLine::Event event;
+    while ((event = masterLine.poll()) != MasterLine::kNone) {
+        switch (event) {
+        case MasterLine::kNone:
+            break;
+        case MasterLine::kLocked:
+            // The impulse marks a minute boundary, NTP tells which one. Taken
+            // at the impulse, the master may run a few seconds off either way.
+            if (globalSystemClock->isInit()) {
+                int64_t impulseMillis = globalSystemClock->getUnixMillis()
+                    - (millis() - masterLine.getLastPulseMillis());
+                masterTime = nearestLocalMinute(impulseMillis);
+            } else {
+                masterTime = currentDisplayedTime;
+            }
+            logger.printf("Following master clock at %02d:%02d\n", masterTime / 60, masterTime % 60);
+            break;
+        case MasterLine::kPulse:
+            masterTime = (masterTime + 1) % 1440;
+            syncDial();
+            break;
+        case MasterLine::kMissing:
+            logger.println(F("Master clock impulse missing, using NTP"));
+            break;
+        case MasterLine::kExtra:
+            logger.println(F("Extra master clock impulse, using NTP"));
+            break;
+        }
+    }
+
+    // Cross-check, the wrapped difference allows for the impulse phase
+    if (masterLine.isFollowing() && globalSystemClock->isInit()) {
+        int16_t deviation = (masterTime - currentTime + 1440 + 720) % 1440 - 720;
+        if (abs(deviation) > MASTER_MAX_DEVIATION_MINUTES) {
+            logger.printf("Master clock %d min off NTP, using NTP\n", deviation);
+            masterLine.reject();
+        }
+    }
+}
+#endif
+
 /**
  * Template function to execute code at regular intervals
  * Prevents blocking delays while maintaining precise timing
@@ -527,45 +1530,86 @@ void runEvery(void (*f)())
  */
 void loop()
 {
-    // Handle incoming web requests
-    server.handleClient();
+    // Handle incoming web requests, held back shortly after a pulse
+    if (networkTxAllowed()) {
+        bool request = requestWaiting(server);
+        server.handleClient();
+        if (request) {
+            noteNetworkTx();
+        }
+    }
+#ifdef HTTPS_ADMIN
+    if (adminHandshakeAllowed()) {
+        bool request = requestWaiting(adminServer);
+        handleAdminClient();
+        if (request) {
+            noteNetworkTx();
+        }
+    }
+#endif
+    provisioning.loop();
 #ifdef OTA
     // Process any OTA update requests
     ArduinoOTA.handle();
 #endif
+    uint32_t ntpRequests = globalSystemClock->getRequestCount();
     globalSystemClock->loop();
+    if (globalSystemClock->getRequestCount() != ntpRequests) {
+        noteNetworkTx();
+    }
+    seedDial();
+#ifdef RTC_DS3231
+    serviceRtc();
+#endif
+#ifdef MASTER_LINE_PIN
+    followMasterLine();
+#endif
 
-    // Primary clock synchronization logic - runs every second
-    runEvery<1000>([]() {
-        if (currentDisplayedTime == currentTime) {
-            // Clock is synchronized - no action needed
-        } else if (currentDisplayedTime < currentTime) {
-            // Clock is behind - advance one minute
-            advance();
-        } else if (currentDisplayedTime > currentTime + 10) {
-            // Clock is significantly ahead - reset to previous day for catch-up
-            currentDisplayedTime -= 1440;
-        }
-    });
+    // Primary clock synchronization logic - runs every second, a deferred
+    // step as soon as the transmissions are out
+    runEvery<1000>(syncDial);
+    if (pulseDeferred) {
+        syncDial();
+    }
 
     // System maintenance tasks - runs every 500ms
     runEvery<500>([]() {
         // Update runtime statistics
-        globalStats.uptimeSeconds = (millis() / 1000);
+        globalStats.uptimeSeconds = micros64() / 1000000;
         globalStats.uptimeSecondsTotal = globalStats.previousSecondsTotal + globalStats.uptimeSeconds;
 
         // Refresh current time from NTP
         setCurrentTime();
 
+        if (WiFi.status() == WL_CONNECTED) {
+            activity.wifiConnectedMillis += 500;
+        }
+
+#ifdef RTC_DS3231
+        // Last-alive time, gives the outage duration after the next boot
+        if (globalSystemClock->isInit()) {
+            rtc.writeHeartbeat(globalSystemClock->getUnixMillis() / 1000);
+        }
+#endif
+
         // Service reset detection and network discovery
         drd.loop();
-        MDNS.update();
+        if (networkTxAllowed()) {
+            MDNS.update();
+        }
     });
 
     // Periodic data persistence - runs every 15 minutes
     runEvery<1000 * 15 * 60>([]() {
         // Save current statistics to survive reboots
-        EEPROM.put(STATS_ADDRESS, globalStats);
-        EEPROM.commit();
+        idleQueue.enqueue(&persistStatsJob);
+#ifdef RTC_DS3231
+        rtcCheckDue = true;
+#endif
     });
+
+    // Deferred maintenance work in the remaining slack
+    if (schedulerHasSlack()) {
+        idleQueue.run(IDLE_SLICE_MICROS);
+    }
 }
@@ -0,0 +1,214 @@
+/**
+ * CTW Nebenuhr - Host tests for the DS3231 driver against a register file
+ *
+ * Run with: pio test -e native
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include <unity.h>
+
+#include <string.h>
+
+#include "Ds3231Rtc.h"
+
+/** The chip's 19 registers, answering only at its address while present. */
+class FakeRegisters : public I2cBus {
+public:
+    uint8_t registers[0x13];
+    bool present = true;
+
+    FakeRegisters() { memset(registers, 0, sizeof(registers)); }
+
+    bool readRegisters(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length) override
+    {
+        if (!accepts(address, reg, length)) {
+            return false;
+        }
+        memcpy(data, registers + reg, length);
+        return true;
+    }
+
+    bool writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length) override
+    {
+        if (!accepts(address, reg, length)) {
+            return false;
+        }
+        memcpy(registers + reg, data, length);
+        return true;
+    }
+
+private:
+    bool accepts(uint8_t address, uint8_t reg, uint8_t length) const
+    {
+        return present && address == Ds3231Rtc::kAddress && reg + length <= (int)sizeof(registers);
+    }
+};
+
+static const uint8_t REG_CONTROL = 0x0E;
+static const uint8_t REG_STATUS = 0x0F;
+static const uint8_t STATUS_OSF = 0x80;
+
+void setUp() { }
+void tearDown() { }
+
+void test_begin_disables_alarm_interrupts()
+{
+    FakeRegisters bus;
+    bus.registers[REG_CONTROL] = 0x1f; // Square wave mode, both alarm interrupts on
+    Ds3231Rtc rtc(bus);
+    TEST_ASSERT_TRUE(rtc.begin());
+    TEST_ASSERT_TRUE(rtc.isPresent());
+    TEST_ASSERT_EQUAL_HEX8(0x1c, bus.registers[REG_CONTROL]);
+}
+
+void test_absent_chip()
+{
+    FakeRegisters bus;
+    bus.present = false;
+    Ds3231Rtc rtc(bus);
+    int64_t seconds;
+    int16_t dial;
+    TEST_ASSERT_FALSE(rtc.begin());
+    TEST_ASSERT_FALSE(rtc.readUnixSeconds(seconds));
+    TEST_ASSERT_FALSE(rtc.readDial(dial));
+    TEST_ASSERT_FALSE(rtc.writeDial(600));
+}
+
+void test_read_decodes_bcd()
+{
+    FakeRegisters bus;
+    // 2024-02-29T23:59:59Z, a Thursday
+    const uint8_t time[7] = { 0x59, 0x59, 0x23, 4, 0x29, 0x02, 0x24 };
+    memcpy(bus.registers, time, sizeof(time));
+    Ds3231Rtc rtc(bus);
+    rtc.begin();
+    int64_t seconds;
+    TEST_ASSERT_TRUE(rtc.readUnixSeconds(seconds));
+    TEST_ASSERT_EQUAL_INT64(1709251199LL, seconds);
+}
+
+void test_write_encodes_bcd()
+{
+    FakeRegisters bus;
+    Ds3231Rtc rtc(bus);
+    rtc.begin();
+    // 2025-03-30T01:59:58Z, a Sunday
+    TEST_ASSERT_TRUE(rtc.writeUnixSeconds(1743299998LL));
+    const uint8_t expected[7] = { 0x58, 0x59, 0x01, 7, 0x30, 0x03, 0x25 };
+    for (int i = 0; i < 7; i++) {
+        TEST_ASSERT_EQUAL_HEX8(expected[i], bus.registers[i]);
+    }
+}
+
+void test_time_round_trip()
+{
+    const int64_t times[] = {
+        946684800LL, // 2000-01-01T00:00:00Z
+        951782400LL, // 2000-02-29T00:00:00Z
+        1735689599LL, // 2024-12-31T23:59:59Z
+        4102444799LL, // 2099-12-31T23:59:59Z, last second of the chip's century
+    };
+    for (int64_t time : times) {
+        FakeRegisters bus;
+        Ds3231Rtc rtc(bus);
+        rtc.begin();
+        int64_t seconds = 0;
+        TEST_ASSERT_TRUE(rtc.writeUnixSeconds(time));
+        TEST_ASSERT_TRUE(rtc.readUnixSeconds(seconds));
+        TEST_ASSERT_EQUAL_INT64(time, seconds);
+    }
+}
+
+void test_write_rejects_outside_century()
+{
+    FakeRegisters bus;
+    Ds3231Rtc rtc(bus);
+    rtc.begin();
+    TEST_ASSERT_FALSE(rtc.writeUnixSeconds(946684799LL));
+    TEST_ASSERT_FALSE(rtc.writeUnixSeconds(4102444800LL));
+}
+
+void test_oscillator_stop_invalidates_time()
+{
+    FakeRegisters bus;
+    Ds3231Rtc rtc(bus);
+    rtc.begin();
+    TEST_ASSERT_TRUE(rtc.writeUnixSeconds(1743299998LL));
+    bus.registers[REG_STATUS] |= STATUS_OSF;
+    int64_t seconds;
+    TEST_ASSERT_FALSE(rtc.readUnixSeconds(seconds));
+
+    // Setting the time marks it valid again, other status bits stay
+    bus.registers[REG_STATUS] |= 0x08;
+    TEST_ASSERT_TRUE(rtc.writeUnixSeconds(1743299998LL));
+    TEST_ASSERT_EQUAL_HEX8(0x08, bus.registers[REG_STATUS]);
+    TEST_ASSERT_TRUE(rtc.readUnixSeconds(seconds));
+}
+
+void test_dial_round_trip()
+{
+    FakeRegisters bus;
+    Ds3231Rtc rtc(bus);
+    rtc.begin();
+    int16_t dial;
+    TEST_ASSERT_FALSE(rtc.readDial(dial));
+    const int16_t positions[] = { 0, 584, 1439 };
+    for (int16_t position : positions) {
+        TEST_ASSERT_TRUE(rtc.writeDial(position));
+        TEST_ASSERT_TRUE(rtc.readDial(dial));
+        TEST_ASSERT_EQUAL_INT(position, dial);
+    }
+}
+
+void test_dial_wraps_negative_position()
+{
+    // syncDial() catching up across midnight goes below zero
+    FakeRegisters bus;
+    Ds3231Rtc rtc(bus);
+    rtc.begin();
+    int16_t dial;
+    TEST_ASSERT_TRUE(rtc.writeDial(-5));
+    TEST_ASSERT_TRUE(rtc.readDial(dial));
+    TEST_ASSERT_EQUAL_INT(1435, dial);
+}
+
+void test_dial_rejects_corrupt_check_byte()
+{
+    FakeRegisters bus;
+    Ds3231Rtc rtc(bus);
+    rtc.begin();
+    TEST_ASSERT_TRUE(rtc.writeDial(600));
+    bus.registers[0x0B] ^= 0x01;
+    int16_t dial;
+    TEST_ASSERT_FALSE(rtc.readDial(dial));
+}
+
+void test_heartbeat_round_trip()
+{
+    FakeRegisters bus;
+    Ds3231Rtc rtc(bus);
+    rtc.begin();
+    int64_t seconds = 0;
+    TEST_ASSERT_TRUE(rtc.writeHeartbeat(1743299998LL));
+    TEST_ASSERT_TRUE(rtc.readHeartbeat(seconds));
+    TEST_ASSERT_EQUAL_INT64(1743299998LL, seconds);
+    // Seconds since 2000 fit the four alarm 1 registers
+    TEST_ASSERT_FALSE(rtc.writeHeartbeat(946684799LL));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_disables_alarm_interrupts);
+    RUN_TEST(test_absent_chip);
+    RUN_TEST(test_read_decodes_bcd);
+    RUN_TEST(test_write_encodes_bcd);
+    RUN_TEST(test_time_round_trip);
+    RUN_TEST(test_write_rejects_outside_century);
+    RUN_TEST(test_oscillator_stop_invalidates_time);
+    RUN_TEST(test_dial_round_trip);
+    RUN_TEST(test_dial_wraps_negative_position);
+    RUN_TEST(test_dial_rejects_corrupt_check_byte);
+    RUN_TEST(test_heartbeat_round_trip);
+    return UNITY_END();
+}
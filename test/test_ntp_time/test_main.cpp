@@ -0,0 +1,111 @@
+/**
+ * CTW Nebenuhr - Host tests for the NTP timestamp arithmetic
+ *
+ * Run with: pio test -e native
+ *
+ * MIT License, Copyright (c) 2025 Wolfgang Jung - see main.cpp for details.
+ */
+#include <unity.h>
+
+#include "NtpTime.h"
+
+static const uint32_t CPU_MHZ = 80;
+static const uint32_t CYCLES_PER_MILLI = CPU_MHZ * 1000;
+static const int64_t UNIX_2025_01_01 = 1735689600LL;
+
+void setUp() { }
+void tearDown() { }
+
+static void writeTimestamp(uint8_t* timestamp, uint32_t seconds, uint32_t fraction)
+{
+    for (int i = 0; i < 4; i++) {
+        timestamp[i] = seconds >> (24 - 8 * i);
+        timestamp[4 + i] = fraction >> (24 - 8 * i);
+    }
+}
+
+void test_era0_timestamp()
+{
+    uint8_t timestamp[8];
+    writeTimestamp(timestamp, UNIX_2025_01_01 + 2208988800UL, 0x80000000UL);
+    TEST_ASSERT_EQUAL_INT64(UNIX_2025_01_01 * 1000000LL + 500000, ntpToUnixMicros(timestamp));
+}
+
+void test_era1_timestamp()
+{
+    // 16 s after the NTP era 0 rollover, 2036-02-07T06:28:32Z
+    uint8_t timestamp[8];
+    writeTimestamp(timestamp, 16, 0);
+    TEST_ASSERT_EQUAL_INT64(2085978512LL * 1000000LL, ntpToUnixMicros(timestamp));
+}
+
+/**
+ * Simulated exchange: local cycle counter and server clock both run true,
+ * the server time is trueUnixMicros at cycle count baseCycles. Requests take
+ * outwardMillis to the server, replies returnMillis back.
+ */
+static ntp_exchange_t simulate(uint32_t baseCycles, int64_t trueUnixMicros, uint32_t outwardMillis,
+    uint32_t processingMillis, uint32_t returnMillis, uint32_t lagMillis)
+{
+    ntp_exchange_t exchange;
+    exchange.cyclesPerMicro = CPU_MHZ;
+    exchange.sendCycles = baseCycles;
+    exchange.serverReceiveMicros = trueUnixMicros + outwardMillis * 1000LL;
+    exchange.serverTransmitMicros = exchange.serverReceiveMicros + processingMillis * 1000LL;
+    exchange.receiveCycles = baseCycles + (outwardMillis + processingMillis + returnMillis) * CYCLES_PER_MILLI;
+    exchange.readCycles = exchange.receiveCycles + lagMillis * CYCLES_PER_MILLI;
+    return exchange;
+}
+
+void test_delay_excludes_server_processing()
+{
+    ntp_result_t result = ntpEvaluate(simulate(0, UNIX_2025_01_01 * 1000000LL, 10, 5, 10, 0));
+    TEST_ASSERT_EQUAL_INT(20000, result.delayMicros);
+    TEST_ASSERT_EQUAL_UINT32(0, result.ageMicros);
+    TEST_ASSERT_EQUAL_INT64(UNIX_2025_01_01 * 1000000LL + 25000, result.unixMicros);
+}
+
+void test_result_independent_of_loop_lag()
+{
+    // However long loop() takes to read the reply, the time returned is the
+    // true time at the moment of reading, so the clock offset does not change
+    const uint32_t lags[] = { 0, 1, 50, 470, 2000 };
+    for (uint32_t lag : lags) {
+        int64_t start = UNIX_2025_01_01 * 1000000LL;
+        ntp_exchange_t exchange = simulate(1000, start, 12, 3, 12, lag);
+        ntp_result_t result = ntpEvaluate(exchange);
+        int64_t trueAtRead = start + (int64_t)(exchange.readCycles - exchange.sendCycles) / CPU_MHZ;
+        TEST_ASSERT_EQUAL_UINT32(lag * 1000, result.ageMicros);
+        TEST_ASSERT_INT64_WITHIN(1, trueAtRead, result.unixMicros);
+    }
+}
+
+void test_cycle_counter_wrap()
+{
+    int64_t start = UNIX_2025_01_01 * 1000000LL;
+    ntp_exchange_t exchange = simulate(0xFFFFFFFFUL - 5 * CYCLES_PER_MILLI, start, 10, 1, 10, 100);
+    ntp_result_t result = ntpEvaluate(exchange);
+    TEST_ASSERT_EQUAL_INT(20000, result.delayMicros);
+    TEST_ASSERT_EQUAL_UINT32(100000, result.ageMicros);
+    TEST_ASSERT_INT64_WITHIN(1, start + 121000, result.unixMicros);
+}
+
+void test_negative_delay_clamped()
+{
+    // Server claims more processing time than the whole round trip took
+    ntp_exchange_t exchange = simulate(0, UNIX_2025_01_01 * 1000000LL, 1, 1, 1, 0);
+    exchange.serverTransmitMicros += 10000;
+    TEST_ASSERT_EQUAL_INT(0, ntpEvaluate(exchange).delayMicros);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_era0_timestamp);
+    RUN_TEST(test_era1_timestamp);
+    RUN_TEST(test_delay_excludes_server_processing);
+    RUN_TEST(test_result_independent_of_loop_lag);
+    RUN_TEST(test_cycle_counter_wrap);
+    RUN_TEST(test_negative_delay_clamped);
+    return UNITY_END();
+}
@@ -0,0 +1,95 @@
+"""
+Estimate battery drain of a clock from its activity counters.
+
+Reads the "activity" block of GET /status (from a device, a saved file or a
+simulator/replay run producing the same keys), scales the counts to one day
+and applies the current figures of a calibration file:
+
+    python3 tools/energy_model.py http://nebenuhr.local/status
+    python3 tools/energy_model.py status.json --calibration my_unit.json
+
+Counts can be overridden to compare configurations, given per day:
+
+    python3 tools/energy_model.py status.json --set ntpRequests=24 --set cpuMHz=80
+"""
+import argparse
+import json
+import os
+import sys
+import urllib.request
+
+DAY_MILLIS = 24 * 3600 * 1000
+PER_DAY = ("pulses", "pulseMillis", "wifiConnectedMillis", "ntpRequests",
+           "httpRequests", "displayUpdates", "flashCommits")
+
+
+def load_json(source):
+    if source.startswith("http://") or source.startswith("https://"):
+        with urllib.request.urlopen(source, timeout=10) as response:
+            return json.load(response)
+    with open(source, encoding="utf-8") as f:
+        return json.load(f)
+
+
+def per_day(activity, overrides):
+    uptime = activity["uptimeMillis"]
+    if uptime <= 0:
+        raise ValueError("uptimeMillis must be positive")
+    day = {key: activity.get(key, 0) * DAY_MILLIS / uptime for key in PER_DAY}
+    day["cpuMHz"] = activity.get("cpuMHz", 80)
+    for key, value in overrides.items():
+        if key not in day:
+            raise ValueError("unknown counter %s" % key)
+        day[key] = value
+    # Connected time cannot exceed the day
+    day["wifiConnectedMillis"] = min(day["wifiConnectedMillis"], DAY_MILLIS)
+    return day
+
+
+def model(day, calibration):
+    """mAh per day for each component."""
+    hours = 24.0
+    mas_to_mah = 1.0 / 3600.0
+    cpu_ma = calibration["cpu_awake_ma"][str(int(day["cpuMHz"]))]
+    return {
+        "cpu": cpu_ma * hours,
+        "wifi": calibration["wifi_connected_ma"] * day["wifiConnectedMillis"] / 3600000.0,
+        "ntp": calibration["ntp_exchange_mas"] * day["ntpRequests"] * mas_to_mah,
+        "http": calibration["http_request_mas"] * day["httpRequests"] * mas_to_mah,
+        "pulses": calibration["pulse_ma"] * day["pulseMillis"] / 3600000.0,
+        "display": calibration["display_idle_ma"] * hours
+        + calibration["display_update_mas"] * day["displayUpdates"] * mas_to_mah,
+        "flash": calibration["flash_commit_mas"] * day["flashCommits"] * mas_to_mah,
+    }
+
+
+def parse_override(text):
+    key, _, value = text.partition("=")
+    return key, float(value)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("status", help="URL or file with the /status JSON")
+    parser.add_argument("--calibration", default=os.path.join(os.path.dirname(
+        os.path.abspath(__file__)), "energy_calibration.json"))
+    parser.add_argument("--set", action="append", default=[], type=parse_override,
+                        metavar="COUNTER=PER_DAY", help="override a counter")
+    args = parser.parse_args()
+
+    status = load_json(args.status)
+    calibration = load_json(args.calibration)
+    day = per_day(status.get("activity", status), dict(args.set))
+    components = model(day, calibration)
+    total = sum(components.values())
+
+    for name, mah in sorted(components.items(), key=lambda item: -item[1]):
+        print("%-8s %8.1f mAh/day  %5.1f %%" % (name, mah, 100.0 * mah / total))
+    print("%-8s %8.1f mAh/day" % ("total", total))
+    usable = calibration["battery_capacity_mah"] * calibration["battery_usable_fraction"]
+    print("battery  %8.1f days (%d mAh usable)" % (usable / total, usable))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,100 @@
+"""
+Compile HTML templates into PROGMEM fragments with typed slots.
+
+Each html/<name>.html is split at {{slot_name}} markers into static
+fragments. The generated src/<Name>Page.h holds the fragments as PROGMEM
+strings, a table pairing every fragment with the slot that follows it and an
+enum class of all slots, so the firmware renders the page with a straight
+walk (see PageTemplate.h) and the compiler warns about unhandled slots.
+
+Runs as PlatformIO pre-build script (extra_scripts) or standalone:
+    python3 tools/html_template.py
+"""
+import os
+import re
+import sys
+
+SLOT = re.compile(r"\{\{([a-z_]+)\}\}")
+
+
+def camel(name):
+    return "".join(part.capitalize() for part in name.split("_"))
+
+
+def c_string(text):
+    """C string literal, split after each newline for readability."""
+    escaped = text.replace("\\", "\\\\").replace('"', '\\"')
+    lines = escaped.split("\n")
+    parts = [line + "\\n" for line in lines[:-1]]
+    if lines[-1]:
+        parts.append(lines[-1])
+    if not parts:
+        return '""'
+    return "\n    ".join('"%s"' % part for part in parts)
+
+
+def compile_template(source, name):
+    with open(source, encoding="utf-8") as f:
+        html = f.read()
+
+    fragments = []
+    slots = []
+    position = 0
+    for match in SLOT.finditer(html):
+        fragments.append((html[position:match.start()], match.group(1)))
+        if match.group(1) not in slots:
+            slots.append(match.group(1))
+        position = match.end()
+    fragments.append((html[position:], None))
+
+    prefix = name.upper() + "_PAGE"
+    enum = camel(name) + "PageSlot"
+    out = []
+    out.append("// Generated by tools/html_template.py from html/%s.html - do not edit" % name)
+    out.append("#pragma once")
+    out.append("")
+    out.append('#include "PageTemplate.h"')
+    out.append("")
+    out.append("enum class %s : uint8_t {" % enum)
+    out.append("    None,")
+    for slot in slots:
+        out.append("    %s," % camel(slot))
+    out.append("};")
+    out.append("")
+    for index, (text, _) in enumerate(fragments):
+        out.append("static const char %s_%d[] PROGMEM = %s;" % (prefix, index, c_string(text)))
+    out.append("")
+    out.append("static const PageFragment %s[] PROGMEM = {" % prefix)
+    for index, (text, slot) in enumerate(fragments):
+        out.append("    { %s_%d, %d, (uint8_t)%s::%s }," % (
+            prefix, index, len(text.encode("utf-8")), enum, camel(slot) if slot else "None"))
+    out.append("};")
+    out.append("")
+    out.append("static const size_t %s_FRAGMENTS = %d;" % (prefix, len(fragments)))
+    return "\n".join(out) + "\n"
+
+
+def main(project_dir):
+    html_dir = os.path.join(project_dir, "html")
+    for entry in sorted(os.listdir(html_dir)):
+        if not entry.endswith(".html"):
+            continue
+        name = entry[:-len(".html")]
+        target = os.path.join(project_dir, "src", camel(name) + "Page.h")
+        header = compile_template(os.path.join(html_dir, entry), name)
+        # Leave the header alone if unchanged, avoids needless rebuilds
+        if os.path.exists(target):
+            with open(target, encoding="utf-8") as f:
+                if f.read() == header:
+                    continue
+        with open(target, "w", encoding="utf-8") as f:
+            f.write(header)
+        print("Generated %s" % os.path.relpath(target, project_dir))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+    main(env.subst("$PROJECT_DIR"))  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        main(os.path.dirname(os.path.dirname(os.path.abspath(sys.argv[0]))))
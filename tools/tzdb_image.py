@@ -0,0 +1,245 @@
+"""
+Build a timezone database image for the flash partition (see TzPartition.h).
+
+Compiles the zonedbx sources of the AceTime library with the ESP8266
+toolchain and links them with a generated linker script that places all
+read-only data right behind the partition header, at the mapped address of
+the filesystem region. The linker resolves every pointer inside the zone
+structures to that address, so the clock uses the image in place. Registry
+address and tz version are taken from the symbol table, the header gets the
+AceTime version the image was built against and the crc32 of the data.
+
+    python3 tools/tzdb_image.py -o tzdb.bin
+    curl -F "file=@tzdb.bin" http://nebenuhr.local/tzdb
+
+Base address and capacity come from the linker script selected in
+platformio.ini (board_build.ldscript). A newer IANA release needs a newer
+AceTime release with the same ACE_TIME_VERSION as the firmware, otherwise
+the clock rejects the image: update the library, build the image and keep
+the firmware (or rebuild both).
+"""
+import argparse
+import configparser
+import glob
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+MAGIC_NUMBER = 0x42445a54  # "TZDB"
+FORMAT_VERSION = 1
+HEADER = struct.Struct("<IHHI8sIIII")
+
+ESP8266_CFLAGS = [
+    "-Os", "-std=gnu++17", "-mlongcalls", "-mtext-section-literals",
+    "-fno-exceptions", "-fno-rtti", "-fdata-sections", "-U__STRICT_ANSI__",
+    "-D__ets__", "-DICACHE_FLASH", "-DESP8266", "-DARDUINO_ARCH_ESP8266",
+    "-DARDUINO=10805", "-DF_CPU=80000000L",
+]
+ESP8266_INCLUDES = [
+    "cores/esp8266", "variants/d1_mini", "tools/sdk/include",
+    "tools/sdk/libc/xtensa-lx106-elf/include", "tools/sdk/lwip2/include",
+]
+
+# Read-only input sections: PROGMEM (.irom.text.<file>.<line>) and rodata
+LINKER_SCRIPT = """
+SECTIONS
+{
+  . = 0x%08x;
+  .tzdb : {
+    *(.irom.text .irom.text.* .irom0.text .irom0.text.*)
+    *(.rodata .rodata.* .rodata1)
+  }
+}
+"""
+
+SHT_SYMTAB = 2
+SHF_ALLOC = 0x2
+
+
+def fail(message):
+    sys.exit("tzdb_image: " + message)
+
+
+def run(command):
+    try:
+        subprocess.run(command, check=True)
+    except (OSError, subprocess.CalledProcessError) as error:
+        fail("%s failed: %s" % (os.path.basename(command[0]), error))
+
+
+def mangle(namespace, name):
+    return "_ZN8ace_time%d%s%d%sE" % (len(namespace), namespace, len(name), name)
+
+
+class Elf32:
+    """Just enough of a little endian ELF32 reader for sections and symbols."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.image = f.read()
+        if self.image[:6] != b"\x7fELF\x01\x01":
+            fail("%s is no little endian ELF32 file" % path)
+        shoff, = struct.unpack_from("<I", self.image, 0x20)
+        shnum, shstrndx = struct.unpack_from("<HH", self.image, 0x30)
+        self.sections = []
+        for index in range(shnum):
+            fields = struct.unpack_from("<IIIIIIIIII", self.image, shoff + index * 40)
+            self.sections.append(dict(zip(
+                ("name", "type", "flags", "addr", "offset", "size", "link", "info",
+                 "align", "entsize"), fields)))
+        names = self.sections[shstrndx]
+        for section in self.sections:
+            section["name"] = self.string(names, section["name"])
+
+    def string(self, table, offset):
+        start = table["offset"] + offset
+        return self.image[start:self.image.index(b"\0", start)].decode()
+
+    def section(self, name):
+        for section in self.sections:
+            if section["name"] == name:
+                return section
+        return None
+
+    def content(self, section):
+        return self.image[section["offset"]:section["offset"] + section["size"]]
+
+    def symbols(self):
+        result = {}
+        for table in self.sections:
+            if table["type"] != SHT_SYMTAB:
+                continue
+            names = self.sections[table["link"]]
+            for offset in range(table["offset"], table["offset"] + table["size"], 16):
+                name, value, size = struct.unpack_from("<III", self.image, offset)
+                if name:
+                    result[self.string(names, name)] = (value, size)
+        return result
+
+
+def read_linker_script(path):
+    """Mapped start and end of the filesystem region."""
+    with open(path, encoding="utf-8") as f:
+        text = f.read()
+    bounds = []
+    for name in ("_FS_start", "_FS_end"):
+        match = re.search(r"\b%s\s*=\s*(0x[0-9a-fA-F]+)" % name, text)
+        if not match:
+            fail("%s not defined in %s" % (name, path))
+        bounds.append(int(match.group(1), 16))
+    return bounds
+
+
+def read_ace_time_version(acetime):
+    with open(os.path.join(acetime, "src", "AceTime.h"), encoding="utf-8") as f:
+        match = re.search(r"#define\s+ACE_TIME_VERSION\s+(\d+)", f.read())
+    if not match:
+        fail("ACE_TIME_VERSION not found in %s" % acetime)
+    return int(match.group(1))
+
+
+def build_elf(args, base, workdir):
+    sources = sorted(glob.glob(os.path.join(args.acetime, "src", args.namespace, "*.cpp")))
+    if not sources:
+        fail("no sources in %s" % os.path.join(args.acetime, "src", args.namespace))
+    cflags = args.cflags.split() if args.cflags is not None else ESP8266_CFLAGS + [
+        "-I" + os.path.join(args.framework, include) for include in ESP8266_INCLUDES]
+    cflags.append("-I" + os.path.join(args.acetime, "src"))
+
+    objects = []
+    for source in sources:
+        target = os.path.join(workdir, os.path.basename(source) + ".o")
+        run([args.toolchain + "g++", "-c", source, "-o", target] + cflags)
+        objects.append(target)
+
+    script = os.path.join(workdir, "tzdb.ld")
+    with open(script, "w", encoding="utf-8") as f:
+        f.write(LINKER_SCRIPT % (base + HEADER.size))
+    elf = os.path.join(workdir, "tzdb.elf")
+    # Unresolved references (code, libraries) make the link fail
+    run([args.toolchain + "g++", "-nostdlib", "-nostartfiles", "-static",
+         "-Wl,--build-id=none", "-Wl,-T," + script, "-Wl,-e,0", "-o", elf] + objects + args.ldflags.split())
+    return Elf32(elf)
+
+
+def build_image(elf, base, namespace, ace_time_version):
+    tzdb = elf.section(".tzdb")
+    if tzdb is None or tzdb["size"] == 0:
+        fail("no zone data linked")
+    # Writable data or code would not work from the read-only flash mapping
+    for section in elf.sections:
+        if section["flags"] & SHF_ALLOC and section["size"] and section is not tzdb:
+            fail("unexpected section %s (%d bytes)" % (section["name"], section["size"]))
+
+    start = base + HEADER.size
+    data = bytes(tzdb["addr"] - start) + elf.content(tzdb)
+    symbols = elf.symbols()
+
+    def lookup(name):
+        symbol = symbols.get(mangle(namespace, name))
+        if symbol is None:
+            fail("symbol %s::%s missing" % (namespace, name))
+        return symbol
+
+    registry, registry_bytes = lookup("kZoneRegistry")
+    version, version_bytes = lookup("kTzDatabaseVersion")
+    tz_version = data[version - start:version - start + version_bytes].rstrip(b"\0")
+    if len(tz_version) >= 8:
+        fail("tz version %r too long" % tz_version)
+
+    header = HEADER.pack(MAGIC_NUMBER, FORMAT_VERSION, registry_bytes // 4,
+                         ace_time_version, tz_version, base, registry - base,
+                         len(data), zlib.crc32(data))
+    return header + data, tz_version.decode(), registry_bytes // 4
+
+
+def default_paths(project_dir):
+    core = os.environ.get("PLATFORMIO_CORE_DIR", os.path.expanduser("~/.platformio"))
+    packages = os.path.join(core, "packages")
+    framework = os.path.join(packages, "framework-arduinoespressif8266")
+    config = configparser.ConfigParser(inline_comment_prefixes=(";", "#"))
+    config.read(os.path.join(project_dir, "platformio.ini"))
+    ldscript = config.get("env:default", "board_build.ldscript", fallback="eagle.flash.1m.ld")
+    return {
+        "acetime": os.path.join(project_dir, ".pio", "libdeps", "default", "AceTime"),
+        "framework": framework,
+        "toolchain": os.path.join(packages, "toolchain-xtensa", "bin", "xtensa-lx106-elf-"),
+        "ldscript": os.path.join(framework, "tools", "sdk", "ld", ldscript),
+    }
+
+
+def main():
+    project_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    defaults = default_paths(project_dir)
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("-o", "--output", default="tzdb.bin")
+    parser.add_argument("--acetime", default=defaults["acetime"], help="AceTime library directory")
+    parser.add_argument("--namespace", default="zonedbx", help="zone database of the library")
+    parser.add_argument("--framework", default=defaults["framework"], help="ESP8266 Arduino core")
+    parser.add_argument("--toolchain", default=defaults["toolchain"], help="compiler prefix")
+    parser.add_argument("--ldscript", default=defaults["ldscript"],
+                        help="firmware linker script, gives the filesystem region")
+    parser.add_argument("--cflags", help="replace the ESP8266 compiler flags and includes")
+    parser.add_argument("--ldflags", default="", help="additional linker flags")
+    args = parser.parse_args()
+
+    fs_start, fs_end = read_linker_script(args.ldscript)
+    ace_time_version = read_ace_time_version(args.acetime)
+    with tempfile.TemporaryDirectory() as workdir:
+        elf = build_elf(args, fs_start, workdir)
+        image, tz_version, zones = build_image(elf, fs_start, args.namespace, ace_time_version)
+    if len(image) > fs_end - fs_start:
+        fail("image needs %d bytes, the filesystem region has %d" % (len(image), fs_end - fs_start))
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print("%s: tz %s, %d zones, AceTime %d, %d of %d bytes at 0x%08x" % (
+        args.output, tz_version, zones, ace_time_version, len(image), fs_end - fs_start, fs_start))
+
+
+if __name__ == "__main__":
+    main()